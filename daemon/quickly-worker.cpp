@@ -0,0 +1,284 @@
+/*
+ * Copyright 2014 Nedim Srndic, University of Tuebingen
+ *
+ * This file is part of libquickly.
+
+ * libquickly is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libquickly is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libquickly.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * quickly-worker.cpp
+ *  Created on: Oct 19, 2026
+ */
+
+/*
+ * A daemon which runs child processes for ThreadPools on other hosts. It
+ * listens on a TCP or unix socket and serves every connection on a thread
+ * of its own: it reads a spawn request, runs the requested pipeline with
+ * the requested limits and streams the output of the last stage back,
+ * followed by the exit status of every stage (see RemoteProtocol.h). If
+ * the pool closes the connection early, the job is killed.
+ *
+ * The daemon runs whatever it is asked to. Without a secret, anyone who
+ * can reach a TCP address can run any command as the user of the daemon,
+ * which includes every local user on a loopback address. A unix socket is
+ * only accessible to the user who started the daemon. With --secret-file,
+ * pools must send the secret in the file (see ThreadPool::addRemoteNode()),
+ * but it travels in the clear, so still only listen on networks whose hosts
+ * are trusted. TCP addresses other than loopback ones are refused unless
+ * --all-interfaces is given, which requires a secret.
+ *
+ * Usage: quickly-worker [--all-interfaces] [--max-jobs N] [--secret-file PATH]
+ *        ADDRESS
+ *   ADDRESS is "host:port", ":port" for the loopback interface, "*:port"
+ *   for all interfaces, or "unix:path".
+ *   --all-interfaces allows a TCP address other than a loopback one.
+ *   --max-jobs N serves at most N connections at a time, the rest wait to
+ *   be accepted. By default, N is the number of execution pipelines
+ *   available on the machine.
+ *   --secret-file PATH rejects requests which do not carry the first line
+ *   of the file at PATH as their secret.
+ */
+
+#include <algorithm>	// max()
+#include <cstdlib>	// EXIT_FAILURE, strtoul()
+#include <cstring>	// strcmp()
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <errno.h>	// errno
+#include <poll.h>	// poll()
+#include <signal.h>	// kill(), signal()
+#include <sys/socket.h>	// accept4(), setsockopt()
+#include <sys/time.h>	// timeval
+#include <sys/types.h>	// pid_t
+#include <sys/wait.h>	// waitpid()
+#include <unistd.h>	// read(), close()
+#include <boost/bind/bind.hpp>
+#include <boost/thread.hpp>
+
+#include "../src/ChildProcess.h"
+#include "../src/RemoteProtocol.h"
+
+using namespace quickly;
+
+// How long a pool may take to send its request, in seconds
+static const int REQUEST_TIMEOUT = 10;
+
+// The secret requests must carry, empty if none
+static std::string secret;
+
+// The number of connections being served, at most max_jobs
+static unsigned int active_jobs = 0;
+static unsigned int max_jobs = 1;
+// Protects active_jobs
+static boost::mutex jobs_mutex;
+// Signalled when a connection has been served
+static boost::condition_variable jobs_cond;
+
+/*
+ * Runs the job requested on a connection and streams its output back.
+ */
+static void serve(int sock) {
+	// Do not let a silent client hold a slot forever
+	struct timeval timeout;
+	timeout.tv_sec = REQUEST_TIMEOUT;
+	timeout.tv_usec = 0;
+	setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	RemoteJob job;
+	if (!job.read(sock, secret)) {
+		close(sock);
+		return;
+	}
+	const std::vector<ChildParams> stages = job.stages();
+	int fd;
+	std::vector<pid_t> pids;
+	const pid_t PID = popenPipeline(stages, &fd, pids, true);
+	if (PID < 0) {
+		const std::string error(POPEN2_MSGS[-PID]);
+		writeFrame(sock, REMOTE_ERROR, error.data(), error.size());
+		close(sock);
+		return;
+	}
+
+	// Forward the output until EOF. The pool sends nothing after the
+	// request, so a readable socket means that it went away.
+	const pid_t group = pids.front();
+	bool lost = false;
+	char buffer[65536];
+	struct pollfd pfds[2];
+	pfds[0].fd = fd;
+	pfds[0].events = POLLIN;
+	pfds[1].fd = sock;
+	pfds[1].events = POLLIN;
+	while (true) {
+		if (poll(pfds, 2, -1) == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			lost = true;
+			break;
+		}
+		if (pfds[1].revents != 0) {
+			lost = true;
+			break;
+		}
+		if (pfds[0].revents == 0) {
+			continue;
+		}
+		const ssize_t n = read(fd, buffer, sizeof(buffer));
+		if (n > 0) {
+			// Blocks while the pool is not reading, which in turn makes the
+			// child block
+			if (!writeFrame(sock, REMOTE_OUTPUT, buffer, n)) {
+				lost = true;
+				break;
+			}
+		} else if (n == 0) {
+			break;
+		} else if (errno != EAGAIN && errno != EINTR) {
+			lost = true;
+			break;
+		}
+	}
+	if (lost) {
+		kill(-group, SIGKILL);
+	}
+	close(fd);
+
+	// Reap all stages and report how they ended
+	std::vector<RemoteStatus> statuses(pids.size());
+	for (size_t i = 0; i < pids.size(); i++) {
+		int status = 0;
+		if (waitpid(pids[i], &status, 0) != pids[i]) {
+			statuses[i].kind = REMOTE_LOST;
+			statuses[i].value = 0U;
+		} else if (WIFEXITED(status)) {
+			statuses[i].kind = REMOTE_EXITED;
+			statuses[i].value = WEXITSTATUS(status);
+		} else {
+			statuses[i].kind = REMOTE_SIGNALED;
+			statuses[i].value = WIFSIGNALED(status) ? WTERMSIG(status) : 0;
+		}
+	}
+	if (!lost) {
+		const std::string payload = encodeExit(statuses);
+		writeFrame(sock, REMOTE_EXIT, payload.data(), payload.size());
+	}
+	close(sock);
+}
+
+/*
+ * Serves a connection, then frees its slot.
+ */
+static void serveJob(int sock) {
+	serve(sock);
+	boost::mutex::scoped_lock lock(jobs_mutex);
+	active_jobs--;
+	jobs_cond.notify_one();
+}
+
+static int usage(const char *name) {
+	std::cerr << "Usage: " << name << " [--all-interfaces] [--max-jobs N] "
+			<< "[--secret-file PATH] ADDRESS" << std::endl
+			<< "Runs child processes for libquickly thread pools. ADDRESS is"
+			<< std::endl << "host:port, :port for the loopback interface, "
+			<< "*:port for all interfaces," << std::endl << "or unix:path. "
+			<< "Addresses other than loopback ones require --all-interfaces,"
+			<< std::endl << "which requires --secret-file. --max-jobs limits "
+			<< "the connections served at a" << std::endl << "time. "
+			<< "--secret-file rejects requests without the first line of PATH."
+			<< std::endl << std::endl << "WARNING: without --secret-file, "
+			<< "TCP mode gives unauthenticated code execution" << std::endl
+			<< "as this user to anyone who can reach the port, including "
+			<< "every local user." << std::endl << "The secret is sent in "
+			<< "the clear." << std::endl;
+	return EXIT_FAILURE;
+}
+
+int main(int argc, char *argv[]) {
+	bool all_interfaces = false;
+	max_jobs = std::max(boost::thread::hardware_concurrency(), 1U);
+	const char *address = (const char *) NULL;
+	const char *secret_file = (const char *) NULL;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--all-interfaces") == 0) {
+			all_interfaces = true;
+		} else if (std::strcmp(argv[i], "--max-jobs") == 0 && i + 1 < argc) {
+			max_jobs = std::strtoul(argv[++i], NULL, 10);
+			if (max_jobs == 0) {
+				return usage(argv[0]);
+			}
+		} else if (std::strcmp(argv[i], "--secret-file") == 0 && i + 1 < argc) {
+			secret_file = argv[++i];
+		} else if (address == (const char *) NULL && argv[i][0] != '-') {
+			address = argv[i];
+		} else {
+			return usage(argv[0]);
+		}
+	}
+	if (address == (const char *) NULL
+			|| (all_interfaces && secret_file == (const char *) NULL)) {
+		return usage(argv[0]);
+	}
+	if (secret_file != (const char *) NULL) {
+		std::ifstream in(secret_file);
+		std::getline(in, secret);
+		if (!in || secret.empty() || secret.size() > REMOTE_MAX_SECRET) {
+			std::cerr << argv[0] << ": cannot read a secret of at most "
+					<< REMOTE_MAX_SECRET << " bytes from " << secret_file
+					<< std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	const int listener = listenRemote(address, all_interfaces);
+	if (listener == -1) {
+		std::cerr << argv[0] << ": cannot listen on " << address;
+		if (errno == EACCES) {
+			std::cerr << ", permission denied (addresses other than loopback "
+					<< "ones require --all-interfaces)";
+		}
+		std::cerr << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	while (true) {
+		// Leave further connections in the backlog while all slots are busy
+		{
+			boost::mutex::scoped_lock lock(jobs_mutex);
+			while (active_jobs >= max_jobs) {
+				jobs_cond.wait(lock);
+			}
+		}
+		const int sock = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+		if (sock == -1) {
+			if (errno == EINTR || errno == ECONNABORTED) {
+				continue;
+			}
+			if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS
+					|| errno == ENOMEM) {
+				// Wait for running jobs to free resources
+				boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+				continue;
+			}
+			std::cerr << argv[0] << ": accept() failed" << std::endl;
+			return EXIT_FAILURE;
+		}
+		{
+			boost::mutex::scoped_lock lock(jobs_mutex);
+			active_jobs++;
+		}
+		boost::thread(boost::bind(serveJob, sock)).detach();
+	}
+}
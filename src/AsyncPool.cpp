@@ -0,0 +1,158 @@
+/*
+ * Copyright 2014 Nedim Srndic, University of Tuebingen
+ *
+ * This file is part of libquickly.
+
+ * libquickly is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libquickly is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libquickly.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * AsyncPool.cpp
+ *  Created on: Oct 19, 2026
+ */
+
+#include <algorithm> // max()
+
+#include <boost/bind/bind.hpp>
+#include <boost/make_shared.hpp>
+
+#include "AsyncPool.h"
+#include "ChildProcess.h"
+
+namespace quickly {
+
+AsyncPool::AsyncPool(unsigned int executor_count, unsigned int child_count) :
+		EXECUTOR_COUNT(executor_count), CHILD_COUNT(child_count), running(0U),
+		waiting(), tasks(), outstanding(0U), stopping(false), mutex(),
+		task_cond(), idle_cond(), executors(), reaper() {
+	if (EXECUTOR_COUNT == 0) {
+		EXECUTOR_COUNT = std::max(boost::thread::hardware_concurrency(), 1U);
+	}
+	if (CHILD_COUNT == 0) {
+		CHILD_COUNT = std::max(boost::thread::hardware_concurrency() - 1, 1U);
+	}
+	for (unsigned int i = 0; i < EXECUTOR_COUNT; i++) {
+		executors.create_thread(boost::bind(&AsyncPool::executorLoop, this));
+	}
+}
+
+AsyncPool::~AsyncPool() {
+	wait();
+	{
+		boost::mutex::scoped_lock lock(mutex);
+		stopping = true;
+	}
+	task_cond.notify_all();
+	executors.join_all();
+}
+
+void AsyncPool::exec(const ChildParams &params, const Callback &done) {
+	{
+		boost::mutex::scoped_lock lock(mutex);
+		outstanding++;
+		if (running == CHILD_COUNT) {
+			waiting.push_back(std::make_pair(params, done));
+			return;
+		}
+		running++;
+	}
+	start(params, done);
+}
+
+void AsyncPool::post(const Task &task) {
+	{
+		boost::mutex::scoped_lock lock(mutex);
+		outstanding++;
+		tasks.push_back(task);
+	}
+	task_cond.notify_one();
+}
+
+void AsyncPool::wait() {
+	boost::mutex::scoped_lock lock(mutex);
+	while (outstanding > 0) {
+		idle_cond.wait(lock);
+	}
+}
+
+void AsyncPool::start(const ChildParams &params, const Callback &done) {
+	int fd;
+	const pid_t PID = popen2(params.getChildProc(), params.getArgv(), &fd,
+			params.getVmLimit(), params.getCpuLimit());
+	if (PID < 0) {
+		ChildResult result;
+		result.error = PID;
+		onReaped(done, result);
+		return;
+	}
+	reaper.watch(PID, fd, boost::bind(&AsyncPool::onReaped, this, done,
+			boost::placeholders::_1));
+}
+
+void AsyncPool::onReaped(const Callback &done, ChildResult &result) {
+	// Hand the result over to an executor without copying the output
+	boost::shared_ptr<ChildResult> moved = boost::make_shared<ChildResult>();
+	moved->output.swap(result.output);
+	moved->status = result.status;
+	moved->error = result.error;
+	{
+		boost::mutex::scoped_lock lock(mutex);
+		tasks.push_back(boost::bind(&AsyncPool::deliver, this, done, moved));
+	}
+	task_cond.notify_one();
+
+	// The child slot is free, start the next waiting job in it
+	std::pair<ChildParams, Callback> next;
+	{
+		boost::mutex::scoped_lock lock(mutex);
+		if (waiting.empty()) {
+			running--;
+			return;
+		}
+		next = waiting.front();
+		waiting.pop_front();
+	}
+	start(next.first, next.second);
+}
+
+void AsyncPool::deliver(const Callback &done,
+		boost::shared_ptr<ChildResult> result) {
+	done(*result);
+}
+
+void AsyncPool::finished() {
+	boost::mutex::scoped_lock lock(mutex);
+	if (--outstanding == 0) {
+		idle_cond.notify_all();
+	}
+}
+
+void AsyncPool::executorLoop() {
+	while (true) {
+		Task task;
+		{
+			boost::mutex::scoped_lock lock(mutex);
+			while (tasks.empty() && !stopping) {
+				task_cond.wait(lock);
+			}
+			if (tasks.empty()) {
+				return;
+			}
+			task = tasks.front();
+			tasks.pop_front();
+		}
+		task();
+		finished();
+	}
+}
+
+} /* namespace quickly */
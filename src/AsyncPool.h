@@ -0,0 +1,196 @@
+/*
+ * Copyright 2014 Nedim Srndic, University of Tuebingen
+ *
+ * This file is part of libquickly.
+
+ * libquickly is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libquickly is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libquickly.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * AsyncPool.h
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef QUICKLY_ASYNCPOOL_H_
+#define QUICKLY_ASYNCPOOL_H_
+
+#include <deque>
+#include <utility>	// std::pair
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include "ChildParams.h"
+#include "ChildReaper.h"
+
+#if __cplusplus >= 202002L && defined(__cpp_impl_coroutine)
+#include <coroutine>
+#define QUICKLY_HAS_COROUTINES 1
+#endif
+
+namespace quickly {
+
+#ifdef QUICKLY_HAS_COROUTINES
+class ExecAwaitable;
+#endif
+
+/*!
+ * \brief An asynchronous interface for running child processes.
+ *
+ * Unlike ThreadPool, which dedicates a thread to every running child,
+ * AsyncPool watches all of its children from a single ChildReaper thread and
+ * runs completion callbacks on a small, fixed set of executor threads. Any
+ * number of jobs can be submitted; at most child_count of them run at the
+ * same time, the rest wait in a queue.
+ *
+ * When compiled as C++20, exec() can also be awaited from a coroutine:
+ *
+ * \code
+ * ChildResult result = co_await pool.exec(params);
+ * \endcode
+ *
+ * The coroutine is resumed on one of the executor threads.
+ */
+class AsyncPool {
+public:
+	//! A function to run on an executor thread.
+	typedef boost::function<void ()> Task;
+	//! A function to call with the result of a child process.
+	typedef boost::function<void (ChildResult &)> Callback;
+private:
+	// The number of executor threads
+	unsigned int EXECUTOR_COUNT;
+	// Maximum number of processes to run concurrently
+	unsigned int CHILD_COUNT;
+	// Number of processes currently running
+	unsigned int running;
+	// Jobs submitted to exec() which wait for a free child slot
+	std::deque<std::pair<ChildParams, Callback> > waiting;
+	// Tasks waiting for an executor thread
+	std::deque<Task> tasks;
+	// Number of submitted jobs and tasks whose callbacks have not yet
+	// returned
+	unsigned int outstanding;
+	// Set when the executor threads should exit
+	bool stopping;
+	// Protects all of the above
+	boost::mutex mutex;
+	// Signalled when a task is queued or stopping is set
+	boost::condition_variable task_cond;
+	// Signalled when outstanding drops to 0
+	boost::condition_variable idle_cond;
+	// The executor threads
+	boost::thread_group executors;
+	// Watches the running children. Declared last so that it is destroyed
+	// first and no callbacks arrive during destruction.
+	ChildReaper reaper;
+
+	// The body of an executor thread
+	void executorLoop();
+	// Starts a child process now. Must be called without holding the mutex.
+	void start(const ChildParams &params, const Callback &done);
+	// Called on the reaper thread when a child has been reaped
+	void onReaped(const Callback &done, ChildResult &result);
+	// Runs a callback on an executor thread
+	void deliver(const Callback &done, boost::shared_ptr<ChildResult> result);
+	// Marks a job or a task as finished
+	void finished();
+
+	// Noncopyable
+	AsyncPool(const AsyncPool &);
+	AsyncPool &operator =(const AsyncPool &);
+public:
+	/*!
+	 * \brief Constructor
+	 *
+	 * \param executor_count the number of threads that run callbacks and
+	 * resume coroutines. If 0 (default), it will be set to the number of
+	 * execution pipelines available on the machine.
+	 * \param child_count the maximum number of concurrent child processes. If
+	 * 0 (default), it will be set to the number one less than the number of
+	 * execution pipelines available on the machine.
+	 */
+	explicit AsyncPool(unsigned int executor_count = 0,
+			unsigned int child_count = 0);
+
+	/*!
+	 * \brief Destructor. Waits until all submitted jobs and tasks finish.
+	 */
+	~AsyncPool();
+
+	/*!
+	 * \brief Runs a child process and calls done with its result on an
+	 * executor thread.
+	 *
+	 * The executable name and argument array in params must stay valid until
+	 * done is called.
+	 */
+	void exec(const ChildParams &params, const Callback &done);
+
+	/*!
+	 * \brief Runs a task on an executor thread.
+	 */
+	void post(const Task &task);
+
+	/*!
+	 * \brief Blocks until all submitted jobs and tasks, including the ones
+	 * they submit in turn, have finished.
+	 */
+	void wait();
+
+#ifdef QUICKLY_HAS_COROUTINES
+	/*!
+	 * \brief Runs a child process. The result is an awaitable which suspends
+	 * the calling coroutine until the child is reaped and yields its
+	 * ChildResult.
+	 */
+	ExecAwaitable exec(const ChildParams &params);
+#endif
+};
+
+#ifdef QUICKLY_HAS_COROUTINES
+/*!
+ * \brief The awaitable returned by AsyncPool::exec(params).
+ */
+class ExecAwaitable {
+private:
+	AsyncPool &pool;
+	ChildParams params;
+	ChildResult result;
+public:
+	ExecAwaitable(AsyncPool &pool, const ChildParams &params) :
+			pool(pool), params(params), result() {
+	}
+	bool await_ready() const noexcept {
+		return false;
+	}
+	void await_suspend(std::coroutine_handle<> handle) {
+		// The callback may run before exec() returns, so nothing may touch
+		// this object after the call
+		pool.exec(params, [this, handle](ChildResult &r) {
+			result = std::move(r);
+			handle.resume();
+		});
+	}
+	ChildResult await_resume() {
+		return std::move(result);
+	}
+};
+
+inline ExecAwaitable AsyncPool::exec(const ChildParams &params) {
+	return ExecAwaitable(*this, params);
+}
+#endif
+
+} /* namespace quickly */
+#endif /* QUICKLY_ASYNCPOOL_H_ */
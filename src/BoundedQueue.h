@@ -0,0 +1,152 @@
+/*
+ * Copyright 2014 Nedim Srndic, University of Tuebingen
+ *
+ * This file is part of libquickly.
+
+ * libquickly is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libquickly is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libquickly.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * BoundedQueue.h
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef QUICKLY_BOUNDEDQUEUE_H_
+#define QUICKLY_BOUNDEDQUEUE_H_
+
+#include <deque>
+
+#include <boost/date_time.hpp>
+#include <boost/thread.hpp>
+
+namespace quickly {
+
+/*!
+ * \brief Statistics collected by a BoundedQueue.
+ */
+struct QueueStats {
+	//! The number of items pushed
+	unsigned long pushes;
+	//! The largest number of items the queue held at once
+	unsigned int max_depth;
+	//! The number of pushes that had to wait for a free place
+	unsigned long push_stalls;
+	//! The total time pushes spent waiting, in microseconds
+	unsigned long long push_stall_us;
+	//! The number of pops that had to wait for an item
+	unsigned long pop_stalls;
+	//! The total time pops spent waiting, in microseconds
+	unsigned long long pop_stall_us;
+
+	QueueStats() :
+			pushes(0UL), max_depth(0U), push_stalls(0UL), push_stall_us(0ULL),
+			pop_stalls(0UL), pop_stall_us(0ULL) {
+	}
+};
+
+/*
+ * A thread-safe FIFO queue holding a limited number of items. Pushing to a
+ * full queue blocks until an item is popped, popping from an empty queue
+ * blocks until an item is pushed or the queue is closed.
+ */
+template<typename item_t>
+class BoundedQueue {
+private:
+	// The queued items
+	std::deque<item_t> items;
+	// The maximum number of items
+	unsigned int capacity;
+	// Set by close(), no more items will be pushed
+	bool closed;
+	// Collected statistics
+	QueueStats stats;
+	// The mutex for synchronization
+	boost::mutex mutex;
+	// Signalled when an item is popped
+	boost::condition_variable not_full;
+	// Signalled when an item is pushed or the queue is closed
+	boost::condition_variable not_empty;
+
+	// Returns the current time
+	static boost::posix_time::ptime now() {
+		return boost::posix_time::microsec_clock::universal_time();
+	}
+public:
+	// Constructor
+	explicit BoundedQueue(unsigned int capacity) :
+			items(), capacity(capacity > 0 ? capacity : 1U), closed(false),
+			stats() {
+	}
+
+	// Appends an item, waiting for a free place if the queue is full
+	void push(const item_t &item);
+	// Removes the first item and stores it in ret, waiting for one if the
+	// queue is empty. Returns false if the queue is closed and empty.
+	bool pop(item_t &ret);
+	// Wakes up all waiting pops once the queue is empty
+	void close();
+	// Returns the statistics collected so far
+	QueueStats getStats() {
+		boost::mutex::scoped_lock lock(mutex);
+		return stats;
+	}
+};
+
+template<typename item_t>
+inline void BoundedQueue<item_t>::push(const item_t &item) {
+	boost::mutex::scoped_lock lock(mutex);
+	if (items.size() >= capacity) {
+		// Only a stall is worth the cost of reading the clock
+		const boost::posix_time::ptime start = now();
+		while (items.size() >= capacity) {
+			not_full.wait(lock);
+		}
+		stats.push_stalls++;
+		stats.push_stall_us += (now() - start).total_microseconds();
+	}
+	items.push_back(item);
+	stats.pushes++;
+	if (items.size() > stats.max_depth) {
+		stats.max_depth = items.size();
+	}
+	not_empty.notify_one();
+}
+
+template<typename item_t>
+inline bool BoundedQueue<item_t>::pop(item_t &ret) {
+	boost::mutex::scoped_lock lock(mutex);
+	if (items.empty() && !closed) {
+		const boost::posix_time::ptime start = now();
+		while (items.empty() && !closed) {
+			not_empty.wait(lock);
+		}
+		stats.pop_stalls++;
+		stats.pop_stall_us += (now() - start).total_microseconds();
+	}
+	if (items.empty()) {
+		return false;
+	}
+	ret = items.front();
+	items.pop_front();
+	not_full.notify_one();
+	return true;
+}
+
+template<typename item_t>
+inline void BoundedQueue<item_t>::close() {
+	boost::mutex::scoped_lock lock(mutex);
+	closed = true;
+	not_empty.notify_all();
+}
+}
+
+#endif /* QUICKLY_BOUNDEDQUEUE_H_ */
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2014 Nedim Srndic, University of Tuebingen
+ *
+ * This file is part of libquickly.
+
+ * libquickly is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libquickly is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libquickly.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Cancellation.cpp
+ *  Created on: Oct 19, 2026
+ */
+
+#include <signal.h>	// kill()
+#include "Cancellation.h"
+
+namespace quickly {
+
+void Cancellation::kill(const Children &children) {
+	if (children.group) {
+		::kill(-children.pids.front(), SIGKILL);
+		return;
+	}
+	for (size_t i = 0; i < children.pids.size(); i++) {
+		::kill(children.pids[i], SIGKILL);
+	}
+}
+
+Cancellation::~Cancellation() {
+	for (std::multimap<unsigned int, Children>::const_iterator it =
+			running.begin(); it != running.end(); ++it) {
+		kill(it->second);
+	}
+}
+
+bool Cancellation::cancel() {
+	boost::mutex::scoped_lock lock(mutex);
+	if (cancelled.exchange(true, boost::memory_order_acq_rel)) {
+		return false;
+	}
+	for (std::multimap<unsigned int, Children>::const_iterator it =
+			running.begin(); it != running.end(); ++it) {
+		kill(it->second);
+	}
+	return true;
+}
+
+void Cancellation::killJob(unsigned int job) {
+	boost::mutex::scoped_lock lock(mutex);
+	killed_jobs.insert(job);
+	typedef std::multimap<unsigned int, Children>::const_iterator Iterator;
+	const std::pair<Iterator, Iterator> range = running.equal_range(job);
+	for (Iterator it = range.first; it != range.second; ++it) {
+		kill(it->second);
+	}
+}
+
+bool Cancellation::enter(unsigned int job, const std::vector<pid_t> &pids,
+		bool group) {
+	Children children;
+	children.pids = pids;
+	children.group = group;
+	boost::mutex::scoped_lock lock(mutex);
+	if (cancelled.load(boost::memory_order_acquire)
+			|| killed_jobs.count(job) != 0) {
+		kill(children);
+		return false;
+	}
+	running.insert(std::make_pair(job, children));
+	return true;
+}
+
+void Cancellation::leave(unsigned int job, pid_t leader) {
+	boost::mutex::scoped_lock lock(mutex);
+	typedef std::multimap<unsigned int, Children>::iterator Iterator;
+	const std::pair<Iterator, Iterator> range = running.equal_range(job);
+	for (Iterator it = range.first; it != range.second; ++it) {
+		if (it->second.pids.front() == leader) {
+			running.erase(it);
+			return;
+		}
+	}
+}
+
+} /* namespace quickly */
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2014 Nedim Srndic, University of Tuebingen
+ *
+ * This file is part of libquickly.
+
+ * libquickly is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libquickly is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libquickly.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Cancellation.h
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef QUICKLY_CANCELLATION_H_
+#define QUICKLY_CANCELLATION_H_
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include <sys/types.h>	// pid_t
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
+
+namespace quickly {
+
+/*
+ * Cancels a run. Once cancelled, no new jobs are started and the child
+ * processes of all running jobs are killed with SIGKILL.
+ *
+ * The worker thread of every job registers the PIDs of its child
+ * process(es) here for as long as they may be killed. If the children run
+ * in a process group of their own, the whole group is killed, including
+ * any processes they forked; otherwise only the children themselves. Single
+ * jobs can be killed as well, e.g. the redundant attempts of a job which was
+ * re-executed speculatively.
+ */
+class Cancellation {
+private:
+	// The child processes of a running job
+	struct Children {
+		// The PIDs of the children, the first one leading the group
+		std::vector<pid_t> pids;
+		// Whether the children run in a process group of their own
+		bool group;
+	};
+
+	// Set once the run is cancelled
+	boost::atomic<bool> cancelled;
+	// The children of the running jobs, by job ID
+	std::multimap<unsigned int, Children> running;
+	// Jobs killed with killJob()
+	std::set<unsigned int> killed_jobs;
+	// Protects running and killed_jobs
+	boost::mutex mutex;
+
+	// Kills the children of a job
+	static void kill(const Children &children);
+
+	// Noncopyable
+	Cancellation(const Cancellation &);
+	Cancellation &operator =(const Cancellation &);
+public:
+	// Constructor
+	Cancellation() :
+			cancelled(false), running(), killed_jobs(), mutex() {
+	}
+	// Destructor. Kills the children which are still registered, so that
+	// none outlive the pool.
+	~Cancellation();
+
+	// Cancels the run and kills all registered children. Returns true if
+	// this call cancelled it, false if it was cancelled already.
+	bool cancel();
+	// Clears the cancellation for a new run
+	void reset() {
+		boost::mutex::scoped_lock lock(mutex);
+		cancelled.store(false, boost::memory_order_release);
+		running.clear();
+		killed_jobs.clear();
+	}
+	// Returns true if the run is cancelled
+	bool isCancelled() const {
+		return cancelled.load(boost::memory_order_acquire);
+	}
+	// Kills the registered children of a job, as well as any that get
+	// registered for it later
+	void killJob(unsigned int job);
+	// Registers the children of a running job, which lead a process group
+	// of their own if group is true. Returns false, and kills them, if the
+	// run is already cancelled or the job killed.
+	bool enter(unsigned int job, const std::vector<pid_t> &pids, bool group);
+	// Unregisters the children whose first PID is leader. Must be called
+	// before any of them is reaped, so that a recycled PID is never killed.
+	void leave(unsigned int job, pid_t leader);
+};
+
+} /* namespace quickly */
+#endif /* QUICKLY_CANCELLATION_H_ */
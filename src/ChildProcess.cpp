@@ -0,0 +1,220 @@
+/*
+ * Copyright 2014 Nedim Srndic, University of Tuebingen
+ *
+ * This file is part of libquickly.
+
+ * libquickly is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libquickly is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libquickly.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * ChildProcess.cpp
+ *  Created on: Oct 19, 2026
+ */
+
+#include <cstdio>	// perror()
+#include <cstdlib>	// EXIT_FAILURE
+
+#include <fcntl.h>	// open(), fcntl()
+#include <signal.h>	// kill()
+#include <sys/prctl.h>	// prctl()
+#include <sys/resource.h> // setrlimit()
+#include <sys/types.h>	// fork(), open()
+#include <sys/wait.h>	// waitpid()
+#include <unistd.h>	// pipe2(), close(), fork(), dup2(), execv(), fcntl()
+#include "ChildProcess.h"
+#include "Tracer.h"
+
+namespace quickly {
+
+const char * POPEN2_MSGS[] = {"", // 0
+								"Call to pipe() failed.", // -1
+								"Call to fork() failed.", // -2
+								"Call to fcntl() using F_GETFL failed.", // -3
+								"Attempt to use non-blocking reads failed.", // -4
+								};
+
+/*
+ * Forks a new process which reads its standard input from in_fd (unless it
+ * is -1) and writes its standard output to out_fd, then runs execv() to run
+ * the child. Standard error goes to /dev/null. If new_group is true, the
+ * child joins the process group pgid, or leads a new one if pgid is 0, and
+ * dies with the forking thread; with in_fd -1, it then reads from
+ * /dev/null.
+ *
+ * Returns the child's PID, or -1 if fork() failed.
+ * Inspired by http://snippets.dzone.com/posts/show/1134
+ */
+static pid_t spawn(const ChildParams &params, int in_fd, int out_fd,
+		pid_t pgid, bool new_group) {
+	const int ERR = STDERR_FILENO;
+
+	Tracer::begin("fork");
+	const pid_t parent = getpid();
+	const pid_t pid = fork();
+	if (pid != 0) {
+		if (pid != -1 && new_group) {
+			// Also set the group here, so that it is in place before anyone
+			// signals it, whichever process runs first
+			setpgid(pid, pgid);
+		}
+		Tracer::end("fork");
+		return pid;
+	}
+
+	// Child process
+	if (new_group) {
+		if (setpgid(0, pgid) == -1) {
+			std::exit(EXIT_FAILURE);
+		}
+		// Outside of the terminal's foreground group, Ctrl-C no longer
+		// reaches the child, so make it die with its parent instead
+		if (prctl(PR_SET_PDEATHSIG, SIGKILL) == -1 || getppid() != parent) {
+			std::exit(EXIT_FAILURE);
+		}
+		// Reading from the terminal would stop the group with SIGTTIN
+		if (in_fd == -1) {
+			const int std_in = open("/dev/null", O_RDONLY);
+			if (std_in == -1 || dup2(std_in, STDIN_FILENO) == -1) {
+				std::exit(EXIT_FAILURE);
+			}
+		}
+	}
+	// Read from the previous stage, if any
+	if (in_fd != -1 && dup2(in_fd, STDIN_FILENO) == -1) {
+		std::exit(EXIT_FAILURE);
+	}
+	// Pipe child's stdout to the next stage or the parent
+	if (dup2(out_fd, STDOUT_FILENO) == -1) {
+		std::exit(EXIT_FAILURE);
+	}
+
+	// Pipe stderr to /dev/null
+	int std_err = open("/dev/null", O_WRONLY);
+	if (std_err == -1) {
+		std::exit(EXIT_FAILURE);
+	}
+	if (dup2(std_err, ERR) == -1) {
+		std::exit(EXIT_FAILURE);
+	}
+
+	/* In order to use the argv parameter, which is of type
+	 * "const char * const *" with execv, which accepts a "char * const *",
+	 * we must use a const_cast. It is safe to use it here, as is discussed
+	 * in http://stackoverflow.com/questions/190184/execv-and-const-ness */
+	char * const *argv_nonconst = const_cast<char * const *>(params.getArgv());
+
+	const unsigned int vm_lim = params.getVmLimit();
+	if (vm_lim != 0U) {
+		// Limit virtual memory size
+		struct rlimit rl;
+		rl.rlim_cur = vm_lim;
+		rl.rlim_max = vm_lim;
+		if (setrlimit(RLIMIT_AS, &rl) == -1) {
+			std::exit(EXIT_FAILURE);
+		}
+	}
+	const unsigned int CPU_lim = params.getCpuLimit();
+	if (CPU_lim != 0) {
+		// Limit CPU time
+		struct rlimit rl;
+		rl.rlim_cur = CPU_lim;
+		rl.rlim_max = CPU_lim;
+		if (setrlimit(RLIMIT_CPU, &rl) == -1) {
+			std::exit(EXIT_FAILURE);
+		}
+	}
+
+	// Replace process image
+	execv(params.getChildProc(), argv_nonconst);
+	// Replace failed, show error and exit
+	std::perror("execv");
+	std::exit(EXIT_FAILURE);
+}
+
+pid_t popen2(const char *proc, const char * const *argv, int *outfp,
+		unsigned int vm_lim, unsigned int CPU_lim) {
+	std::vector<ChildParams> stages(1,
+			ChildParams(proc, argv, vm_lim, CPU_lim));
+	std::vector<pid_t> pids;
+	return popenPipeline(stages, outfp, pids);
+}
+
+pid_t popenPipeline(const std::vector<ChildParams> &stages, int *outfp,
+		std::vector<pid_t> &pids, bool new_group) {
+	const int READ = 0;
+	const int WRITE = 1;
+	pids.clear();
+
+	// The read end of the previous stage's output
+	int in_fd = -1;
+	pid_t error = 0;
+	for (size_t i = 0; i < stages.size(); i++) {
+		// Create a pipe. Both ends are close-on-exec so that children forked
+		// concurrently by other threads do not inherit them and hold the pipe
+		// open; dup2() clears the flag on the child's own stdin and stdout.
+		int p_stdout[2];
+		Tracer::begin("pipe");
+		const int r = pipe2(p_stdout, O_CLOEXEC);
+		Tracer::end("pipe");
+		if (r == -1) {
+			error = -1;
+			break;
+		}
+
+		// All stages share the first stage's process group, if any
+		const pid_t pid = spawn(stages[i], in_fd, p_stdout[WRITE],
+				pids.empty() ? 0 : pids.front(), new_group);
+		// Only the children use these ends
+		close(p_stdout[WRITE]);
+		if (in_fd != -1) {
+			close(in_fd);
+		}
+		in_fd = p_stdout[READ];
+		if (pid == -1) {
+			// Fork failed
+			error = -2;
+			break;
+		}
+		pids.push_back(pid);
+	}
+
+	// Use non-blocking reads on the last stage's output
+	if (error == 0) {
+		int flags = fcntl(in_fd, F_GETFL, 0);
+		if (flags == -1) {
+			perror("fcntl F_GETFL");
+			error = -3;
+		} else if (fcntl(in_fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+			perror("fcntl F_SETFL");
+			error = -4;
+		}
+	}
+
+	if (error != 0) {
+		// Take down the stages which were already started
+		if (in_fd != -1) {
+			close(in_fd);
+		}
+		for (size_t i = 0; i < pids.size(); i++) {
+			kill(pids[i], SIGKILL);
+			waitpid(pids[i], NULL, 0);
+		}
+		pids.clear();
+		return error;
+	}
+
+	// Return a handle to the output of the last stage
+	*outfp = in_fd;
+	return pids.back();
+}
+
+} /* namespace quickly */
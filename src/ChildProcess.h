@@ -0,0 +1,76 @@
+/*
+ * Copyright 2014 Nedim Srndic, University of Tuebingen
+ *
+ * This file is part of libquickly.
+
+ * libquickly is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libquickly is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libquickly.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * ChildProcess.h
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef QUICKLY_CHILDPROCESS_H_
+#define QUICKLY_CHILDPROCESS_H_
+
+#include <vector>
+
+#include <sys/types.h>	// pid_t
+
+#include "ChildParams.h"
+
+namespace quickly {
+
+/*
+ * Error messages for the negative return values of popen2(), indexed by
+ * the negated return value.
+ */
+extern const char * POPEN2_MSGS[];
+
+/*
+ * Forks a new process and connects its standard output to the parent's
+ * standard input, then runs execv() to run the child. The read end of the
+ * pipe is stored in outfp and is non-blocking.
+ *
+ * Returns the child's PID when OK or a negative number if an error is
+ * encountered.
+ */
+pid_t popen2(const char *proc, const char * const *argv, int *outfp,
+		unsigned int vm_lim = 0U, unsigned int CPU_lim = 0U);
+
+/*
+ * Starts a non-empty pipeline of child processes, like a shell does for
+ * "stage1 | stage2 | stage3". The standard output of every stage is
+ * connected directly to the standard input of the next one, so the data
+ * never passes through the parent. The read end of the last stage's output
+ * is stored in outfp and is non-blocking, and the PIDs of all stages are
+ * stored in pids.
+ *
+ * If new_group is true, all stages run in a new process group whose ID is
+ * the PID of the first stage, so the whole pipeline, including any
+ * processes it forks, can be signalled at once. Such a group no longer
+ * receives the signals of the terminal, so the first stage reads its
+ * standard input from /dev/null instead of stopping on SIGTTIN, and all
+ * stages are killed if the thread which started them exits (which
+ * includes the parent exiting, e.g. on Ctrl-C). Otherwise the stages stay
+ * in the parent's process group and inherit its standard input.
+ *
+ * Returns the PID of the last stage when OK or a negative number (see
+ * POPEN2_MSGS) if an error is encountered, in which case the stages which
+ * were already started are killed.
+ */
+pid_t popenPipeline(const std::vector<ChildParams> &stages, int *outfp,
+		std::vector<pid_t> &pids, bool new_group = false);
+
+} /* namespace quickly */
+#endif /* QUICKLY_CHILDPROCESS_H_ */
@@ -0,0 +1,175 @@
+/*
+ * Copyright 2014 Nedim Srndic, University of Tuebingen
+ *
+ * This file is part of libquickly.
+
+ * libquickly is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libquickly is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libquickly.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * ChildReaper.cpp
+ *  Created on: Oct 19, 2026
+ */
+
+#include <climits>	// PIPE_BUF
+#include <cstdio>	// perror()
+
+#include <errno.h>	// errno
+#include <fcntl.h>	// O_CLOEXEC, O_NONBLOCK
+#include <poll.h>	// poll()
+#include <signal.h>	// kill()
+#include <unistd.h>	// pipe2(), read(), write(), close()
+#include "ChildReaper.h"
+
+namespace quickly {
+
+ChildReaper::ChildReaper() :
+		incoming(), mutex(), stopping(false), thread() {
+	if (pipe2(wake_pipe, O_CLOEXEC | O_NONBLOCK) == -1) {
+		throw "ChildReaper: Call to pipe() failed.";
+	}
+	thread = boost::thread(&ChildReaper::loop, this);
+}
+
+ChildReaper::~ChildReaper() {
+	{
+		boost::mutex::scoped_lock lock(mutex);
+		stopping = true;
+	}
+	wake();
+	thread.join();
+	close(wake_pipe[0]);
+	close(wake_pipe[1]);
+}
+
+void ChildReaper::watch(pid_t pid, int fd, const Callback &done) {
+	Child *child = new Child;
+	child->pid = pid;
+	child->fd = fd;
+	child->done = done;
+	{
+		boost::mutex::scoped_lock lock(mutex);
+		incoming.push_back(child);
+	}
+	wake();
+}
+
+void ChildReaper::wake() {
+	const char c = 0;
+	// A full pipe already guarantees a wakeup, so the result is ignored
+	ssize_t r = write(wake_pipe[1], &c, 1);
+	(void) r;
+}
+
+void ChildReaper::loop() {
+	// Children owned by this thread
+	std::vector<Child *> children;
+	// The descriptors passed to poll() and the children they belong to
+	std::vector<struct pollfd> fds;
+	std::vector<Child *> polled;
+	char read_buf[PIPE_BUF];
+	// Set while poll() keeps failing
+	bool poll_failed = false;
+	while (true) {
+		{
+			boost::mutex::scoped_lock lock(mutex);
+			children.insert(children.end(), incoming.begin(), incoming.end());
+			incoming.clear();
+			if (stopping) {
+				break;
+			}
+		}
+
+		// Watch the wake pipe and every child that still has its output open
+		fds.clear();
+		polled.clear();
+		struct pollfd wake_fd = { wake_pipe[0], POLLIN, 0 };
+		fds.push_back(wake_fd);
+		bool exiting = false;
+		for (size_t i = 0; i < children.size(); i++) {
+			if (children[i]->fd != -1) {
+				struct pollfd child_fd = { children[i]->fd, POLLIN, 0 };
+				fds.push_back(child_fd);
+				polled.push_back(children[i]);
+			} else {
+				exiting = true;
+			}
+		}
+		// Children which closed their output but have not exited yet are
+		// polled for with waitpid() every 10 milliseconds
+		if (poll(&fds[0], fds.size(), exiting ? 10 : -1) == -1
+				&& errno != EINTR) {
+			// Out of memory or descriptors. Back off instead of spinning and
+			// report only the first failure in a row.
+			if (!poll_failed) {
+				std::perror("ChildReaper: poll");
+				poll_failed = true;
+			}
+			boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+			continue;
+		}
+		poll_failed = false;
+		while (read(wake_pipe[0], read_buf, sizeof(read_buf)) > 0) {
+		}
+
+		// Drain every readable pipe
+		for (size_t i = 0; i < polled.size(); i++) {
+			if (fds[i + 1].revents == 0) {
+				continue;
+			}
+			Child *child = polled[i];
+			while (child->fd != -1) {
+				ssize_t bytes_read = read(child->fd, read_buf, sizeof(read_buf));
+				if (bytes_read > 0) { // Success
+					child->result.output.append(read_buf, bytes_read);
+				} else if (bytes_read == -1 && errno == EAGAIN) { // Empty pipe
+					break;
+				} else if (bytes_read == -1 && errno == EINTR) {
+					continue;
+				} else { // EOF or error
+					if (bytes_read == -1) {
+						kill(child->pid, SIGKILL);
+					}
+					close(child->fd);
+					child->fd = -1;
+				}
+			}
+		}
+
+		// Reap the children whose output is closed
+		for (size_t i = 0; i < children.size();) {
+			Child *child = children[i];
+			if (child->fd == -1
+					&& waitpid(child->pid, &child->result.status, WNOHANG)
+							== child->pid) {
+				child->done(child->result);
+				delete child;
+				children[i] = children.back();
+				children.pop_back();
+			} else {
+				i++;
+			}
+		}
+	}
+
+	// Shutting down, kill whatever is left
+	for (size_t i = 0; i < children.size(); i++) {
+		if (children[i]->fd != -1) {
+			close(children[i]->fd);
+		}
+		kill(children[i]->pid, SIGKILL);
+		waitpid(children[i]->pid, NULL, 0);
+		delete children[i];
+	}
+}
+
+} /* namespace quickly */
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2014 Nedim Srndic, University of Tuebingen
+ *
+ * This file is part of libquickly.
+
+ * libquickly is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libquickly is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libquickly.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * ChildReaper.h
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef QUICKLY_CHILDREAPER_H_
+#define QUICKLY_CHILDREAPER_H_
+
+#include <string>
+#include <vector>
+
+#include <sys/types.h>	// pid_t
+#include <sys/wait.h>	// WIFEXITED()
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+namespace quickly {
+
+/*!
+ * \brief The outcome of running a single child process.
+ */
+class ChildResult {
+public:
+	//! The entire standard output of the child process.
+	std::string output;
+	//! The exit status of the child as returned by waitpid().
+	int status;
+	//! 0 if the child was started, otherwise the negative popen2() error code.
+	int error;
+
+	ChildResult() :
+			output(), status(0), error(0) {
+	}
+
+	/*!
+	 * \brief Returns true if the child was started and exited normally
+	 * (i.e., it was not killed by a signal).
+	 */
+	bool exitedNormally() const {
+		return error == 0 && WIFEXITED(status);
+	}
+	/*!
+	 * \brief Returns the exit code of the child. Only meaningful if
+	 * exitedNormally() returns true.
+	 */
+	int exitCode() const {
+		return WEXITSTATUS(status);
+	}
+};
+
+/*
+ * A single thread that multiplexes the output pipes of any number of child
+ * processes using poll(), reads their output and reaps them once their
+ * output is closed. Waiting children cost a file descriptor each, but no
+ * threads.
+ */
+class ChildReaper {
+public:
+	// The function to call when a child has been reaped. It runs on the
+	// reaper thread, so it must not block.
+	typedef boost::function<void (ChildResult &)> Callback;
+private:
+	// A child process being watched
+	struct Child {
+		pid_t pid;
+		// The read end of the child's output pipe, -1 after EOF
+		int fd;
+		ChildResult result;
+		Callback done;
+	};
+
+	// Children handed over by watch() but not yet seen by the reaper thread
+	std::vector<Child *> incoming;
+	// Protects incoming and stopping
+	boost::mutex mutex;
+	// A pipe used to wake the reaper thread from poll()
+	int wake_pipe[2];
+	// Set when the reaper thread should exit
+	bool stopping;
+	// The reaper thread itself
+	boost::thread thread;
+
+	// The body of the reaper thread
+	void loop();
+	// Interrupts a poll() in progress
+	void wake();
+
+	// Noncopyable
+	ChildReaper(const ChildReaper &);
+	ChildReaper &operator =(const ChildReaper &);
+public:
+	// Constructor, starts the reaper thread
+	ChildReaper();
+	// Destructor, stops the reaper thread. Children still being watched are
+	// killed and their callbacks are not invoked.
+	~ChildReaper();
+
+	/*
+	 * Starts watching a child process started by popen2(). The reaper takes
+	 * ownership of fd. The callback is invoked once the child has closed its
+	 * output and has been reaped.
+	 */
+	void watch(pid_t pid, int fd, const Callback &done);
+};
+
+} /* namespace quickly */
+#endif /* QUICKLY_CHILDREAPER_H_ */
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2014 Nedim Srndic, University of Tuebingen
+ *
+ * This file is part of libquickly.
+
+ * libquickly is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libquickly is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libquickly.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * ConsumerStage.cpp
+ *  Created on: Oct 19, 2026
+ */
+
+#include <iostream>
+#include <sstream>
+
+#include <boost/bind/bind.hpp>
+
+#include "ConsumerStage.h"
+
+namespace quickly {
+
+ConsumerStage::ConsumerStage(DataActionBase *data_action,
+		OutputSplitter *splitter, unsigned int consumer_count,
+		unsigned int capacity, Tracer *tracer, Metrics *metrics,
+		Cancellation *cancellation, DeliveryLog *log) :
+		data_action(data_action), splitter(splitter), queue(capacity),
+		consumers(), tracer(tracer), metrics(metrics),
+		cancellation(cancellation), log(log) {
+	for (unsigned int i = 0; i < consumer_count; i++) {
+		consumers.create_thread(boost::bind(&ConsumerStage::consume, this, i));
+	}
+}
+
+ConsumerStage::~ConsumerStage() {
+	finish();
+}
+
+void ConsumerStage::finish() {
+	queue.close();
+	consumers.join_all();
+}
+
+void ConsumerStage::consume(unsigned int index) {
+	if (tracer != (Tracer *) NULL) {
+		std::ostringstream name;
+		name << "consumer " << index;
+		Tracer::bind(tracer->track(name.str()));
+	}
+	JobOutput output;
+	while (queue.pop(output)) {
+		if (metrics != (Metrics *) NULL) {
+			metrics->consumer_queue_depth.add(-1);
+		}
+		const bool ok = runDataActions(data_action, splitter, output.id,
+				output.count, *output.buffer, cancellation, metrics);
+		if (!ok) {
+			std::cerr << "ConsumerStage: could not split the output of a batch"
+					<< std::endl;
+		}
+		if (log != (DeliveryLog *) NULL) {
+			log->record(output.id, output.count, ok);
+		}
+		// Free the buffer before waiting for the next one
+		output.buffer.reset();
+	}
+	Tracer::bind((TraceBuffer *) NULL);
+}
+
+} /* namespace quickly */
@@ -0,0 +1,115 @@
+/*
+ * Copyright 2014 Nedim Srndic, University of Tuebingen
+ *
+ * This file is part of libquickly.
+
+ * libquickly is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libquickly is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libquickly.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * ConsumerStage.h
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef QUICKLY_CONSUMERSTAGE_H_
+#define QUICKLY_CONSUMERSTAGE_H_
+
+#include <cstddef>	// size_t
+#include <sstream>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include "BoundedQueue.h"
+#include "Cancellation.h"
+#include "DataAction.h"
+#include "DeliveryLog.h"
+#include "Metrics.h"
+#include "Tracer.h"
+
+namespace quickly {
+
+/*
+ * The complete output of a child process which handled count jobs with
+ * consecutive IDs starting at id.
+ */
+struct JobOutput {
+	unsigned int id;
+	unsigned int count;
+	boost::shared_ptr<std::stringstream> buffer;
+	// The size of the output in bytes
+	size_t bytes;
+};
+
+/*
+ * A set of consumer threads which run the data actions on finished child
+ * outputs. Worker threads push outputs into a bounded queue and are free to
+ * start a new child right away, so parsing and child execution overlap. When
+ * the consumers fall behind, the queue fills up and pushes block.
+ */
+class ConsumerStage {
+private:
+	// An action to perform on the results obtained from the child processes
+	DataActionBase *data_action;
+	// Splits the output of a batch into per-job outputs, may be NULL
+	OutputSplitter *splitter;
+	// Outputs waiting for a consumer
+	BoundedQueue<JobOutput> queue;
+	// The consumer threads
+	boost::thread_group consumers;
+	// Records the data actions, may be NULL
+	Tracer *tracer;
+	// Live metrics of the pool, may be NULL
+	Metrics *metrics;
+	// Cancelled by data actions whose verdict is STOP, may be NULL
+	Cancellation *cancellation;
+	// Records whether the data actions of every output ran, may be NULL
+	DeliveryLog *log;
+
+	// The body of a consumer thread
+	void consume(unsigned int index);
+
+	// Noncopyable
+	ConsumerStage(const ConsumerStage &);
+	ConsumerStage &operator =(const ConsumerStage &);
+public:
+	// Constructor, starts the consumer threads. Each of them records on its
+	// own track of the tracer, if given. The depth of the queue is kept in
+	// the metrics, if given. The outcome of every output is recorded in the
+	// log, if given.
+	ConsumerStage(DataActionBase *data_action, OutputSplitter *splitter,
+			unsigned int consumer_count, unsigned int capacity,
+			Tracer *tracer = (Tracer *) NULL, Metrics *metrics = (Metrics *) NULL,
+			Cancellation *cancellation = (Cancellation *) NULL,
+			DeliveryLog *log = (DeliveryLog *) NULL);
+	// Destructor, calls finish()
+	~ConsumerStage();
+
+	// Queues an output, blocking while the queue is full
+	void push(const JobOutput &output) {
+		// Counted before the push, so that the depth never drops below 0
+		if (metrics != (Metrics *) NULL) {
+			metrics->consumer_queue_depth.add(1);
+		}
+		queue.push(output);
+	}
+	// Waits until all queued outputs have been consumed and stops the
+	// consumer threads
+	void finish();
+	// Returns the statistics of the queue
+	QueueStats getStats() {
+		return queue.getStats();
+	}
+};
+
+} /* namespace quickly */
+#endif /* QUICKLY_CONSUMERSTAGE_H_ */
@@ -20,9 +20,57 @@
  *  Created on: Jan 18, 2012
  */
 
-
-
+#include "Cancellation.h"
 #include "DataAction.h"
+#include "Metrics.h"
+#include "Tracer.h"
 
 namespace quickly {
+
+/*
+ * Runs one doFull action and acts upon its verdict.
+ */
+static void runAction(DataActionBase *data_action, unsigned int id,
+		std::stringstream &databuf, Cancellation *cancellation) {
+	TraceSpan span("doFull", id);
+	DataActionBase *action = data_action->create(id);
+	action->doFull(databuf);
+	const DataActionBase::Verdict verdict = action->verdict();
+	delete action;
+	if (verdict == DataActionBase::STOP
+			&& cancellation != (Cancellation *) NULL && cancellation->cancel()) {
+		Tracer::instant("cancel", id);
+	}
+}
+
+bool runDataActions(DataActionBase *data_action, OutputSplitter *splitter,
+		unsigned int id, unsigned int count, std::stringstream &databuf,
+		Cancellation *cancellation, Metrics *metrics) {
+	if (splitter == (OutputSplitter *) NULL) {
+		// Run the doFull action with the buffered data
+		runAction(data_action, id, databuf, cancellation);
+		if (metrics != (Metrics *) NULL) {
+			metrics->jobs_finished.add(1);
+		}
+		return true;
+	}
+
+	// Split the output of a batch and run one doFull action per job
+	std::vector<std::string> parts;
+	Tracer::begin("split", id);
+	const bool split = splitter->split(databuf, id, count, parts);
+	Tracer::end("split", id);
+	if (!split || parts.size() != count) {
+		return false;
+	}
+	for (unsigned int i = 0; i < count; i++) {
+		std::stringstream part(parts[i]);
+		runAction(data_action, id + i, part, cancellation);
+	}
+	if (metrics != (Metrics *) NULL) {
+		metrics->jobs_finished.add(count);
+	}
+	return true;
+}
+
 }
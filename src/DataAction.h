@@ -24,8 +24,13 @@
 #define QUICKLY_DATAACTION_H_
 
 #include <sstream>	// std::stringstream
+#include <string>
+#include <vector>
 
 namespace quickly {
+class Cancellation;
+class Metrics;
+
 /*!
  * \brief A class representing an action to perform upon the data that is returned
  * from a child process.
@@ -68,6 +73,26 @@ public:
 	 * \param databuf a stream of the entire data output of the child process.
 	 */
 	virtual void doFull(std::stringstream &databuf) = 0;
+
+	/*!
+	 * \brief What the ThreadPool should do after a job's data action ran.
+	 */
+	enum Verdict {
+		CONTINUE,	//!< Keep running jobs.
+		STOP		//!< Cancel the run: start no more jobs and kill running children.
+	};
+
+	/*!
+	 * \brief Returns the verdict on the data seen by doFull().
+	 *
+	 * Gets called right after doFull(). Override it to end a run early, e.g.
+	 * when a search has found what it was looking for.
+	 *
+	 * \return CONTINUE by default.
+	 */
+	virtual Verdict verdict() {
+		return CONTINUE;
+	}
 	
 	/*!
      * \brief A virtual destructor.
@@ -75,5 +100,47 @@ public:
 	virtual ~DataActionBase() {}
 };
 
+/*!
+ * \brief A class which splits the output of a child process that handled a
+ * batch of jobs into the outputs of the individual jobs.
+ *
+ * Needed when ThreadPool batching is enabled. This is an abstract base class.
+ */
+class OutputSplitter {
+public:
+	/*!
+	 * \brief Splits the output of a batch.
+	 *
+	 * \param databuf a stream of the entire data output of the child process.
+	 * \param first_id the ID of the first job in the batch.
+	 * \param count the number of jobs in the batch. Their IDs are consecutive.
+	 * \param parts the output of every job, in job ID order. Must hold exactly
+	 * count elements when the method returns true.
+	 * \return false if the output cannot be split, in which case no job of
+	 * the batch is considered to be successful.
+	 */
+	virtual bool split(std::stringstream &databuf, unsigned int first_id,
+			unsigned int count, std::vector<std::string> &parts) = 0;
+
+	/*!
+	 * \brief A virtual destructor.
+	 */
+	virtual ~OutputSplitter() {}
+};
+
+/*
+ * Runs the data action(s) on the output of a child process which handled
+ * count jobs with consecutive IDs starting at id. Without a splitter, count
+ * must be 1 and a single doFull() action runs on databuf. Returns false if
+ * the splitter failed, in which case no action runs. An action whose verdict
+ * is STOP cancels the run through cancellation, unless it is NULL. The jobs
+ * are counted as finished in the metrics, unless they are NULL, if the
+ * actions ran; the caller reports the jobs of a failed split.
+ */
+bool runDataActions(DataActionBase *data_action, OutputSplitter *splitter,
+		unsigned int id, unsigned int count, std::stringstream &databuf,
+		Cancellation *cancellation = (Cancellation *) NULL,
+		Metrics *metrics = (Metrics *) NULL);
+
 }
 #endif /* QUICKLY_DATAACTION_H_ */
@@ -0,0 +1,81 @@
+/*
+ * Copyright 2014 Nedim Srndic, University of Tuebingen
+ *
+ * This file is part of libquickly.
+
+ * libquickly is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libquickly is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libquickly.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * DeliveryLog.h
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef QUICKLY_DELIVERYLOG_H_
+#define QUICKLY_DELIVERYLOG_H_
+
+#include <vector>
+
+#include <boost/thread.hpp>
+
+namespace quickly {
+
+/*
+ * Records whether the data actions of a successful child ran, for outputs
+ * which are delivered after their worker thread has finished, i.e. on a
+ * consumer thread or out of the reorder window. The ThreadPool reports such
+ * jobs only once their outcome is recorded, because the output of a batch
+ * may still fail to be split.
+ */
+class DeliveryLog {
+public:
+	// The outcome of the delivery of an output
+	struct Outcome {
+		// The first job and the number of jobs of the output
+		unsigned int id;
+		unsigned int count;
+		// Whether the data actions ran
+		bool ok;
+	};
+private:
+	// The outcomes recorded since the last take()
+	std::vector<Outcome> outcomes;
+	// Protects outcomes
+	boost::mutex mutex;
+
+	// Noncopyable
+	DeliveryLog(const DeliveryLog &);
+	DeliveryLog &operator =(const DeliveryLog &);
+public:
+	// Constructor
+	DeliveryLog() :
+			outcomes(), mutex() {
+	}
+	// Records the outcome of an output
+	void record(unsigned int id, unsigned int count, bool ok) {
+		Outcome outcome;
+		outcome.id = id;
+		outcome.count = count;
+		outcome.ok = ok;
+		boost::mutex::scoped_lock lock(mutex);
+		outcomes.push_back(outcome);
+	}
+	// Moves the outcomes recorded so far into taken
+	void take(std::vector<Outcome> &taken) {
+		taken.clear();
+		boost::mutex::scoped_lock lock(mutex);
+		taken.swap(outcomes);
+	}
+};
+
+} /* namespace quickly */
+#endif /* QUICKLY_DELIVERYLOG_H_ */
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2014 Nedim Srndic, University of Tuebingen
+ *
+ * This file is part of libquickly.
+
+ * libquickly is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libquickly is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libquickly.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * JobClaims.cpp
+ *  Created on: Oct 19, 2026
+ */
+
+#include "JobClaims.h"
+
+namespace quickly {
+
+bool JobClaims::start(unsigned int job) {
+	boost::mutex::scoped_lock lock(mutex);
+	if (resolved[job]) {
+		return false;
+	}
+	attempts[job]++;
+	return true;
+}
+
+bool JobClaims::claim(unsigned int job) {
+	boost::mutex::scoped_lock lock(mutex);
+	if (resolved[job]) {
+		return false;
+	}
+	attempts[job]--;
+	resolved[job] = true;
+	return true;
+}
+
+bool JobClaims::fail(unsigned int job) {
+	boost::mutex::scoped_lock lock(mutex);
+	attempts[job]--;
+	if (resolved[job] || attempts[job] > 0) {
+		return false;
+	}
+	resolved[job] = true;
+	return true;
+}
+
+bool JobClaims::isResolved(unsigned int job) {
+	boost::mutex::scoped_lock lock(mutex);
+	return resolved[job];
+}
+
+} /* namespace quickly */
@@ -0,0 +1,72 @@
+/*
+ * Copyright 2014 Nedim Srndic, University of Tuebingen
+ *
+ * This file is part of libquickly.
+
+ * libquickly is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libquickly is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libquickly.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * JobClaims.h
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef QUICKLY_JOBCLAIMS_H_
+#define QUICKLY_JOBCLAIMS_H_
+
+#include <vector>
+
+#include <boost/thread.hpp>
+
+namespace quickly {
+
+/*
+ * Decides which of several attempts of the same job reports its outcome,
+ * when straggler jobs are re-executed speculatively. The first attempt to
+ * succeed claims the job and delivers its output; the others are dropped.
+ * The job fails only when its last attempt fails without anyone having
+ * claimed it. Either way, exactly one attempt resolves the job.
+ */
+class JobClaims {
+private:
+	// The number of running attempts of every job
+	std::vector<unsigned int> attempts;
+	// Whether every job has been resolved
+	std::vector<bool> resolved;
+	// Protects all of the above
+	boost::mutex mutex;
+
+	// Noncopyable
+	JobClaims(const JobClaims &);
+	JobClaims &operator =(const JobClaims &);
+public:
+	// Constructor
+	explicit JobClaims(unsigned int job_count) :
+			attempts(job_count, 0U), resolved(job_count, false), mutex() {
+	}
+
+	// Registers a new attempt of a job. Returns false, registering nothing,
+	// if the job has been resolved already.
+	bool start(unsigned int job);
+	// Called by a successful attempt before delivering its output. Returns
+	// true if it is the first one, which resolves the job.
+	bool claim(unsigned int job);
+	// Called by a failed or dropped attempt. Returns true if it was the last
+	// attempt of a job which nobody claimed, which resolves the job as
+	// failed.
+	bool fail(unsigned int job);
+	// Returns true if the job has been resolved
+	bool isResolved(unsigned int job);
+};
+
+} /* namespace quickly */
+#endif /* QUICKLY_JOBCLAIMS_H_ */
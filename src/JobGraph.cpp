@@ -0,0 +1,103 @@
+/*
+ * Copyright 2014 Nedim Srndic, University of Tuebingen
+ *
+ * This file is part of libquickly.
+
+ * libquickly is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libquickly is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libquickly.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * JobGraph.cpp
+ *  Created on: Oct 19, 2026
+ */
+
+#include <algorithm>	// max()
+
+#include "JobGraph.h"
+
+namespace quickly {
+
+bool JobGraph::prepare() {
+	const unsigned int job_count = dependents.size();
+	missing = prerequisites;
+	skipped.assign(job_count, false);
+	ready = std::priority_queue<std::pair<double, long long> >();
+
+	// Sort the jobs topologically (Kahn's algorithm)
+	std::vector<unsigned int> order;
+	order.reserve(job_count);
+	std::vector<unsigned int> remaining(prerequisites);
+	for (unsigned int job = 0; job < job_count; job++) {
+		if (remaining[job] == 0) {
+			order.push_back(job);
+		}
+	}
+	for (size_t i = 0; i < order.size(); i++) {
+		const std::vector<unsigned int> &next = dependents[order[i]];
+		for (size_t j = 0; j < next.size(); j++) {
+			if (--remaining[next[j]] == 0) {
+				order.push_back(next[j]);
+			}
+		}
+	}
+	if (order.size() != job_count) {
+		return false;
+	}
+
+	// The critical path of a job is its cost plus the longest critical path
+	// among its dependents, so compute them in reverse order
+	priority.assign(job_count, 0.0);
+	for (size_t i = order.size(); i-- > 0;) {
+		const unsigned int job = order[i];
+		double longest = 0.0;
+		for (size_t j = 0; j < dependents[job].size(); j++) {
+			longest = std::max(longest, priority[dependents[job][j]]);
+		}
+		priority[job] = costs[job] + longest;
+	}
+
+	for (unsigned int job = 0; job < job_count; job++) {
+		if (missing[job] == 0) {
+			push(job);
+		}
+	}
+	return true;
+}
+
+void JobGraph::finished(unsigned int job, bool success,
+		std::vector<unsigned int> &skipped_jobs) {
+	if (success) {
+		for (size_t i = 0; i < dependents[job].size(); i++) {
+			const unsigned int next = dependents[job][i];
+			if (--missing[next] == 0 && !skipped[next]) {
+				push(next);
+			}
+		}
+		return;
+	}
+
+	// Skip everything downstream of the failed job
+	std::vector<unsigned int> stack(dependents[job]);
+	while (!stack.empty()) {
+		const unsigned int next = stack.back();
+		stack.pop_back();
+		if (skipped[next]) {
+			continue;
+		}
+		skipped[next] = true;
+		skipped_jobs.push_back(next);
+		stack.insert(stack.end(), dependents[next].begin(),
+				dependents[next].end());
+	}
+}
+
+} /* namespace quickly */
@@ -0,0 +1,109 @@
+/*
+ * Copyright 2014 Nedim Srndic, University of Tuebingen
+ *
+ * This file is part of libquickly.
+
+ * libquickly is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libquickly is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libquickly.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * JobGraph.h
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef QUICKLY_JOBGRAPH_H_
+#define QUICKLY_JOBGRAPH_H_
+
+#include <queue>
+#include <utility>	// std::pair
+#include <vector>
+
+namespace quickly {
+
+/*
+ * The dependencies between the jobs of a ThreadPool, forming a directed
+ * acyclic graph. A job becomes ready once all of its prerequisites have
+ * finished successfully. Among the ready jobs, the one with the longest
+ * remaining critical path (the most expensive chain of jobs which depend on
+ * it, including itself) comes first, which keeps the threads busy until the
+ * end. Ties are broken by the lower job ID.
+ */
+class JobGraph {
+private:
+	// The jobs depending on every job
+	std::vector<std::vector<unsigned int> > dependents;
+	// The number of prerequisites of every job
+	std::vector<unsigned int> prerequisites;
+	// The number of dependencies added
+	unsigned int edges;
+	// The estimated cost of every job
+	std::vector<double> costs;
+	// The critical path length of every job, computed by prepare()
+	std::vector<double> priority;
+	// The number of unfinished prerequisites of every job during a run
+	std::vector<unsigned int> missing;
+	// Whether a job was skipped because a prerequisite failed
+	std::vector<bool> skipped;
+	// The ready jobs, by priority
+	std::priority_queue<std::pair<double, long long> > ready;
+
+	// Queues a ready job
+	void push(unsigned int job) {
+		// Negating the ID makes lower IDs win ties
+		ready.push(std::make_pair(priority[job], -(long long) job));
+	}
+public:
+	// Constructor for a graph of job_count jobs without dependencies
+	explicit JobGraph(unsigned int job_count) :
+			dependents(job_count), prerequisites(job_count, 0U), edges(0U),
+			costs(job_count, 1.0), priority(), missing(), skipped(), ready() {
+	}
+
+	// Makes job depend on prerequisite
+	void addDependency(unsigned int job, unsigned int prerequisite) {
+		dependents[prerequisite].push_back(job);
+		prerequisites[job]++;
+		edges++;
+	}
+	// Returns true if any dependency was added, as opposed to only costs
+	bool hasDependencies() const {
+		return edges > 0;
+	}
+	// Sets the estimated cost of a job, 1 by default
+	void setCost(unsigned int job, double cost) {
+		costs[job] = cost;
+	}
+
+	// Computes the priorities and queues the jobs without prerequisites.
+	// Returns false if the dependencies contain a cycle.
+	bool prepare();
+	// Returns true if a job is ready
+	bool hasReady() const {
+		return !ready.empty();
+	}
+	// Returns the ready job with the highest priority
+	unsigned int top() const {
+		return (unsigned int) -ready.top().second;
+	}
+	// Removes the ready job with the highest priority
+	void pop() {
+		ready.pop();
+	}
+	// Marks a job as finished. On success, its dependents may become ready.
+	// On failure, all jobs which transitively depend on it are skipped and
+	// appended to skipped_jobs.
+	void finished(unsigned int job, bool success,
+			std::vector<unsigned int> &skipped_jobs);
+};
+
+} /* namespace quickly */
+#endif /* QUICKLY_JOBGRAPH_H_ */
@@ -0,0 +1,58 @@
+/*
+ * Copyright 2014 Nedim Srndic, University of Tuebingen
+ *
+ * This file is part of libquickly.
+
+ * libquickly is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libquickly is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libquickly.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * MemoryBudget.cpp
+ *  Created on: Oct 19, 2026
+ */
+
+#include "MemoryBudget.h"
+
+namespace quickly {
+
+void MemoryBudget::enter(unsigned int job) {
+	boost::mutex::scoped_lock lock(mutex);
+	active.insert(job);
+}
+
+void MemoryBudget::leave(unsigned int job) {
+	boost::mutex::scoped_lock lock(mutex);
+	active.erase(active.find(job));
+	changed.notify_all();
+}
+
+void MemoryBudget::acquire(unsigned int job, size_t bytes) {
+	boost::mutex::scoped_lock lock(mutex);
+	while (used + bytes > limit && *active.begin() != job) {
+		changed.wait(lock);
+	}
+	used += bytes;
+	if (used > peak) {
+		peak = used;
+	}
+}
+
+void MemoryBudget::release(size_t bytes) {
+	if (bytes == 0) {
+		return;
+	}
+	boost::mutex::scoped_lock lock(mutex);
+	used -= bytes;
+	changed.notify_all();
+}
+
+} /* namespace quickly */
@@ -0,0 +1,120 @@
+/*
+ * Copyright 2014 Nedim Srndic, University of Tuebingen
+ *
+ * This file is part of libquickly.
+
+ * libquickly is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libquickly is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libquickly.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * MemoryBudget.h
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef QUICKLY_MEMORYBUDGET_H_
+#define QUICKLY_MEMORYBUDGET_H_
+
+#include <cstddef>	// size_t
+#include <set>
+#include <sstream>
+
+#include <boost/thread.hpp>
+
+namespace quickly {
+
+/*
+ * A limit on the number of bytes of child output held in memory by all
+ * threads of a ThreadPool together.
+ *
+ * A worker thread acquires memory before every read from its child's pipe
+ * and blocks while the budget is exhausted. Its child then blocks as soon as
+ * the pipe is full, but stays alive. To guarantee progress, the oldest
+ * running job (the one with the smallest ID) may always exceed the budget:
+ * all the outputs waiting for it in a reorder buffer can only be freed once
+ * it finishes.
+ */
+class MemoryBudget {
+private:
+	// The maximum number of bytes
+	size_t limit;
+	// The number of bytes currently in use
+	size_t used;
+	// The peak number of bytes in use
+	size_t peak;
+	// The IDs of the running jobs
+	std::multiset<unsigned int> active;
+	// Protects all of the above
+	mutable boost::mutex mutex;
+	// Signalled when memory is released or the oldest job changes
+	boost::condition_variable changed;
+
+	// Noncopyable
+	MemoryBudget(const MemoryBudget &);
+	MemoryBudget &operator =(const MemoryBudget &);
+public:
+	// Constructor
+	explicit MemoryBudget(size_t limit) :
+			limit(limit), used(0), peak(0), active() {
+	}
+
+	// Registers a running job
+	void enter(unsigned int job);
+	// Unregisters a running job
+	void leave(unsigned int job);
+	// Takes bytes from the budget on behalf of a registered job, blocking
+	// while there is not enough left unless the job is the oldest one
+	void acquire(unsigned int job, size_t bytes);
+	// Returns bytes to the budget
+	void release(size_t bytes);
+
+	// Returns true if the whole budget is in use
+	bool exhausted() const {
+		boost::mutex::scoped_lock lock(mutex);
+		return used >= limit;
+	}
+	// Returns the number of bytes currently in use
+	size_t getUsage() const {
+		boost::mutex::scoped_lock lock(mutex);
+		return used;
+	}
+	// Returns the peak number of bytes in use
+	size_t getPeak() const {
+		boost::mutex::scoped_lock lock(mutex);
+		return peak;
+	}
+};
+
+/*
+ * An output buffer whose size is charged to a MemoryBudget. The charge is
+ * returned to the budget when the buffer is destroyed, wherever that
+ * happens.
+ */
+class BudgetedBuffer: public std::stringstream {
+private:
+	MemoryBudget *budget;
+	// The number of bytes charged to the budget
+	size_t charged;
+public:
+	explicit BudgetedBuffer(MemoryBudget *budget) :
+			std::stringstream(), budget(budget), charged(0) {
+	}
+	virtual ~BudgetedBuffer() {
+		budget->release(charged);
+	}
+	// Records bytes which were acquired from the budget and stored here
+	void charge(size_t bytes) {
+		charged += bytes;
+	}
+};
+
+} /* namespace quickly */
+#endif /* QUICKLY_MEMORYBUDGET_H_ */
@@ -0,0 +1,141 @@
+/*
+ * Copyright 2014 Nedim Srndic, University of Tuebingen
+ *
+ * This file is part of libquickly.
+
+ * libquickly is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libquickly is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libquickly.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Metrics.cpp
+ *  Created on: Oct 19, 2026
+ */
+
+#include <cstdio>	// rename()
+#include <fstream>
+#include <iomanip>	// setw()
+#include <string>
+
+#include <time.h>	// clock_gettime()
+#include "Metrics.h"
+
+namespace quickly {
+
+Histogram::Histogram() :
+		sum_us(0ULL) {
+	for (unsigned int i = 0; i <= BUCKETS; i++) {
+		buckets[i].store(0ULL, boost::memory_order_relaxed);
+	}
+}
+
+void Histogram::observe(unsigned long long us) {
+	unsigned int i = 0;
+	for (unsigned long long bound = FIRST_BOUND_US; i < BUCKETS && us > bound;
+			bound *= 2) {
+		i++;
+	}
+	buckets[i].fetch_add(1ULL, boost::memory_order_relaxed);
+	sum_us.fetch_add(us, boost::memory_order_relaxed);
+}
+
+unsigned long long Histogram::getCount() const {
+	unsigned long long count = 0;
+	for (unsigned int i = 0; i <= BUCKETS; i++) {
+		count += getBucket(i);
+	}
+	return count;
+}
+
+unsigned long long Metrics::now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+// Writes the header and value of a counter or a gauge
+static void writeValue(std::ostream &out, const char *name, const char *type,
+		const char *help, long long value) {
+	out << "# HELP " << name << ' ' << help << '\n' << "# TYPE " << name << ' '
+			<< type << '\n' << name << ' ' << value << '\n';
+}
+
+// Writes a duration given in microseconds as exact decimal seconds
+static void writeSeconds(std::ostream &out, unsigned long long us) {
+	const char fill = out.fill('0');
+	out << us / 1000000 << '.' << std::setw(6) << us % 1000000;
+	out.fill(fill);
+}
+
+// Writes a histogram with cumulative buckets, in seconds
+static void writeHistogram(std::ostream &out, const char *name,
+		const char *help, const Histogram &histogram) {
+	out << "# HELP " << name << ' ' << help << '\n' << "# TYPE " << name
+			<< " histogram\n";
+	unsigned long long cumulative = 0;
+	unsigned long long bound = Histogram::FIRST_BOUND_US;
+	for (unsigned int i = 0; i < Histogram::BUCKETS; i++, bound *= 2) {
+		cumulative += histogram.getBucket(i);
+		out << name << "_bucket{le=\"";
+		writeSeconds(out, bound);
+		out << "\"} " << cumulative << '\n';
+	}
+	cumulative += histogram.getBucket(Histogram::BUCKETS);
+	out << name << "_bucket{le=\"+Inf\"} " << cumulative << '\n' << name
+			<< "_sum ";
+	writeSeconds(out, histogram.getSumUs());
+	out << '\n' << name << "_count " << cumulative << '\n';
+}
+
+void Metrics::writePrometheus(std::ostream &out) const {
+	writeValue(out, "quickly_jobs_started_total", "counter",
+			"Jobs started.", jobs_started.get());
+	writeValue(out, "quickly_jobs_finished_total", "counter",
+			"Jobs whose child exited normally and whose output was delivered.",
+			jobs_finished.get());
+	writeValue(out, "quickly_jobs_failed_total", "counter",
+			"Jobs whose child could not be started or did not exit normally, "
+			"or whose batch output could not be split.",
+			jobs_failed.get());
+	writeValue(out, "quickly_speculative_starts_total", "counter",
+			"Extra attempts of straggler jobs started by speculative re-execution.",
+			speculative_starts.get());
+	writeValue(out, "quickly_bytes_read_total", "counter",
+			"Bytes read from child processes.", bytes_read.get());
+	writeHistogram(out, "quickly_spawn_latency_seconds",
+			"Time taken to spawn a child process.", spawn_latency);
+	writeHistogram(out, "quickly_job_duration_seconds",
+			"Time from spawning a child until its output was delivered.",
+			job_duration);
+	writeValue(out, "quickly_jobs_pending", "gauge",
+			"Jobs which have not been started yet.", jobs_pending.get());
+	writeValue(out, "quickly_threads_running", "gauge",
+			"Worker threads currently running.", threads_running.get());
+	writeValue(out, "quickly_consumer_queue_depth", "gauge",
+			"Outputs waiting for a consumer thread.", consumer_queue_depth.get());
+	writeValue(out, "quickly_reorder_window_depth", "gauge",
+			"Outputs held in the reorder window, waiting for earlier jobs.",
+			reorder_window_depth.get());
+}
+
+bool Metrics::writePrometheus(const char *path) const {
+	const std::string tmp_path = std::string(path) + ".tmp";
+	{
+		std::ofstream out(tmp_path.c_str());
+		writePrometheus(out);
+		if (!out.good()) {
+			return false;
+		}
+	}
+	return std::rename(tmp_path.c_str(), path) == 0;
+}
+
+} /* namespace quickly */
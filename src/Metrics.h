@@ -0,0 +1,162 @@
+/*
+ * Copyright 2014 Nedim Srndic, University of Tuebingen
+ *
+ * This file is part of libquickly.
+
+ * libquickly is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libquickly is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libquickly.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Metrics.h
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef QUICKLY_METRICS_H_
+#define QUICKLY_METRICS_H_
+
+#include <ostream>
+
+#include <boost/atomic.hpp>
+
+namespace quickly {
+
+/*!
+ * \brief A monotonically increasing count.
+ */
+class Counter {
+private:
+	boost::atomic<unsigned long long> value;
+public:
+	Counter() :
+			value(0ULL) {
+	}
+	//! Adds n to the count.
+	void add(unsigned long long n = 1ULL) {
+		value.fetch_add(n, boost::memory_order_relaxed);
+	}
+	//! Returns the count.
+	unsigned long long get() const {
+		return value.load(boost::memory_order_relaxed);
+	}
+};
+
+/*!
+ * \brief A value which can go up and down.
+ */
+class Gauge {
+private:
+	boost::atomic<long long> value;
+public:
+	Gauge() :
+			value(0LL) {
+	}
+	//! Adds n (which may be negative) to the value.
+	void add(long long n) {
+		value.fetch_add(n, boost::memory_order_relaxed);
+	}
+	//! Sets the value.
+	void set(long long n) {
+		value.store(n, boost::memory_order_relaxed);
+	}
+	//! Returns the value.
+	long long get() const {
+		return value.load(boost::memory_order_relaxed);
+	}
+};
+
+/*!
+ * \brief A distribution of durations over exponentially growing buckets,
+ * from 100 microseconds up to about 105 seconds.
+ */
+class Histogram {
+public:
+	//! The number of buckets, not counting the overflow bucket.
+	static const unsigned int BUCKETS = 21;
+	//! The upper bound of the first bucket, in microseconds. Every following
+	//! bucket doubles it.
+	static const unsigned long long FIRST_BOUND_US = 100ULL;
+private:
+	// The number of observations per bucket, the last one for overflows
+	boost::atomic<unsigned long long> buckets[BUCKETS + 1];
+	// The sum of all observations, in microseconds
+	boost::atomic<unsigned long long> sum_us;
+public:
+	Histogram();
+	//! Records a duration given in microseconds.
+	void observe(unsigned long long us);
+	//! Returns the number of observations in a bucket (not cumulative).
+	unsigned long long getBucket(unsigned int i) const {
+		return buckets[i].load(boost::memory_order_relaxed);
+	}
+	//! Returns the number of observations.
+	unsigned long long getCount() const;
+	//! Returns the sum of all observations, in microseconds.
+	unsigned long long getSumUs() const {
+		return sum_us.load(boost::memory_order_relaxed);
+	}
+};
+
+/*!
+ * \brief The live metrics of a ThreadPool.
+ *
+ * All metrics are updated with atomic operations only, so they may be read
+ * at any time from any thread, including while a run is in progress.
+ * Counters accumulate over all runs of the pool.
+ */
+class Metrics {
+public:
+	//! Jobs started (batched jobs count individually).
+	Counter jobs_started;
+	//! Jobs whose child exited normally and whose output was delivered.
+	Counter jobs_finished;
+	//! Jobs whose child could not be started or did not exit normally, or
+	//! whose batch output could not be split. Jobs killed or skipped because
+	//! the run was cancelled do not count.
+	Counter jobs_failed;
+	//! Extra attempts of straggler jobs started by speculative re-execution.
+	Counter speculative_starts;
+	//! Bytes read from child processes.
+	Counter bytes_read;
+	//! Time taken to spawn a child process.
+	Histogram spawn_latency;
+	//! Time from spawning a child until its output was delivered.
+	Histogram job_duration;
+	//! Jobs which have not been started yet.
+	Gauge jobs_pending;
+	//! Worker threads currently running.
+	Gauge threads_running;
+	//! Outputs waiting for a consumer thread.
+	Gauge consumer_queue_depth;
+	//! Outputs held in the reorder window, waiting for earlier jobs.
+	Gauge reorder_window_depth;
+
+	/*!
+	 * \brief Returns the current time of the monotonic clock in
+	 * microseconds, for measuring durations.
+	 */
+	static unsigned long long now();
+
+	/*!
+	 * \brief Writes all metrics in the Prometheus text exposition format.
+	 */
+	void writePrometheus(std::ostream &out) const;
+
+	/*!
+	 * \brief Writes all metrics in the Prometheus text exposition format to a
+	 * file. The file is replaced atomically, so readers never see a partial
+	 * file. Returns false if it cannot be written.
+	 */
+	bool writePrometheus(const char *path) const;
+};
+
+} /* namespace quickly */
+#endif /* QUICKLY_METRICS_H_ */
@@ -0,0 +1,482 @@
+/*
+ * Copyright 2014 Nedim Srndic, University of Tuebingen
+ *
+ * This file is part of libquickly.
+
+ * libquickly is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libquickly is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libquickly.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * RemoteProtocol.cpp
+ *  Created on: Oct 19, 2026
+ */
+
+#include <cstring>	// strlen(), memcpy(), memcmp()
+
+#include <errno.h>	// errno
+#include <fcntl.h>	// fcntl()
+#include <poll.h>	// poll()
+#include <stdint.h>	// uint32_t
+#include <netdb.h>	// getaddrinfo()
+#include <netinet/in.h>	// IPPROTO_TCP
+#include <netinet/tcp.h>	// TCP_NODELAY
+#include <arpa/inet.h>	// htonl(), ntohl()
+#include <sys/socket.h>	// socket(), connect(), bind(), listen(), send(), recv()
+#include <sys/stat.h>	// umask()
+#include <sys/un.h>	// sockaddr_un
+#include <unistd.h>	// close(), unlink()
+#include "RemoteProtocol.h"
+
+namespace quickly {
+
+static const char MAGIC[4] = {'Q', 'K', 'W', '1'};
+static const char UNIX_PREFIX[] = "unix:";
+
+/*
+ * Sends all bytes, without raising SIGPIPE if the peer is gone.
+ */
+static bool writeAll(int fd, const char *data, size_t length) {
+	while (length > 0) {
+		const ssize_t n = send(fd, data, length, MSG_NOSIGNAL);
+		if (n == -1 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			return false;
+		}
+		data += n;
+		length -= n;
+	}
+	return true;
+}
+
+/*
+ * Receives exactly length bytes.
+ */
+static bool readAll(int fd, char *data, size_t length) {
+	while (length > 0) {
+		const ssize_t n = recv(fd, data, length, 0);
+		if (n == -1 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			return false;
+		}
+		data += n;
+		length -= n;
+	}
+	return true;
+}
+
+static void putInt(std::string &out, unsigned int value) {
+	const uint32_t net = htonl(value);
+	out.append((const char *) &net, sizeof(net));
+}
+
+static void putString(std::string &out, const char *value) {
+	const size_t length = std::strlen(value);
+	putInt(out, length);
+	out.append(value, length);
+}
+
+static bool readInt(int fd, unsigned int &value) {
+	uint32_t net;
+	if (!readAll(fd, (char *) &net, sizeof(net))) {
+		return false;
+	}
+	value = ntohl(net);
+	return true;
+}
+
+/*
+ * Receives a string, taking its length from the bytes remaining for the
+ * request.
+ */
+static bool readString(int fd, std::string &value, unsigned int &remaining) {
+	unsigned int length;
+	if (!readInt(fd, length) || length > remaining) {
+		return false;
+	}
+	remaining -= length;
+	value.resize(length);
+	return length == 0 || readAll(fd, &value[0], length);
+}
+
+/*
+ * Compares a secret sent by a pool with the expected one, taking the same
+ * time wherever they differ.
+ */
+static bool sameSecret(const std::string &sent, const std::string &secret) {
+	unsigned char diff = sent.size() != secret.size();
+	for (size_t i = 0; i < secret.size(); i++) {
+		diff |= (unsigned char) (secret[i] ^ (i < sent.size() ? sent[i] : 0));
+	}
+	return diff == 0;
+}
+
+/*
+ * Splits a "host:port" address, returning false if there is no port.
+ */
+static bool splitAddress(const char *address, std::string &host,
+		std::string &port) {
+	const std::string s(address);
+	const size_t colon = s.rfind(':');
+	if (colon == std::string::npos || colon + 1 == s.size()) {
+		return false;
+	}
+	host = s.substr(0, colon);
+	port = s.substr(colon + 1);
+	// Allow IPv6 addresses in brackets
+	if (host.size() >= 2 && host[0] == '[' && host[host.size() - 1] == ']') {
+		host = host.substr(1, host.size() - 2);
+	}
+	return true;
+}
+
+/*
+ * Fills in the address of a unix socket, returning false if the path is
+ * too long.
+ */
+static bool unixAddress(const char *address, struct sockaddr_un &addr) {
+	const char *path = address + sizeof(UNIX_PREFIX) - 1;
+	if (std::strlen(path) >= sizeof(addr.sun_path)) {
+		return false;
+	}
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	std::strcpy(addr.sun_path, path);
+	return true;
+}
+
+static bool isUnix(const char *address) {
+	return std::strncmp(address, UNIX_PREFIX, sizeof(UNIX_PREFIX) - 1) == 0;
+}
+
+static bool isLoopback(const struct sockaddr *addr) {
+	if (addr->sa_family == AF_INET) {
+		const struct sockaddr_in *in = (const struct sockaddr_in *) addr;
+		return (ntohl(in->sin_addr.s_addr) >> 24) == 127;
+	}
+	if (addr->sa_family == AF_INET6) {
+		const struct sockaddr_in6 *in6 = (const struct sockaddr_in6 *) addr;
+		return IN6_IS_ADDR_LOOPBACK(&in6->sin6_addr);
+	}
+	return false;
+}
+
+/*
+ * Connects the non-blocking socket fd, checking every 10 ms whether the
+ * connection is still wanted, and makes it blocking once connected. A unix
+ * socket whose daemon has a full backlog refuses at once, so that connect()
+ * is retried.
+ */
+static bool connectWithin(int fd, const struct sockaddr *addr,
+		socklen_t length, const boost::function<bool ()> &abandoned) {
+	int error = connect(fd, addr, length) == 0 ? 0 : errno;
+	struct pollfd pfd;
+	pfd.fd = fd;
+	pfd.events = POLLOUT;
+	for (unsigned int i = 0; error != 0 && i < REMOTE_CONNECT_TIMEOUT * 100;
+			i++) {
+		if (error != EINPROGRESS && error != EAGAIN && error != EINTR) {
+			return false;
+		}
+		if (abandoned && abandoned()) {
+			return false;
+		}
+		if (error == EAGAIN) {
+			poll(NULL, 0, 10);
+			error = connect(fd, addr, length) == 0 ? 0 : errno;
+			continue;
+		}
+		const int r = poll(&pfd, 1, 10);
+		if (r == -1 && errno != EINTR) {
+			return false;
+		}
+		if (r == 1) {
+			socklen_t error_length = sizeof(error);
+			if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &error_length) == -1
+					|| error != 0) {
+				return false;
+			}
+		} else {
+			error = EINPROGRESS;
+		}
+	}
+	if (error != 0) {
+		return false;
+	}
+	const int flags = fcntl(fd, F_GETFL);
+	return flags != -1 && fcntl(fd, F_SETFL, flags & ~O_NONBLOCK) != -1;
+}
+
+int connectRemote(const char *address,
+		const boost::function<bool ()> &abandoned) {
+	if (isUnix(address)) {
+		struct sockaddr_un addr;
+		if (!unixAddress(address, addr)) {
+			return -1;
+		}
+		const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK,
+				0);
+		if (fd == -1) {
+			return -1;
+		}
+		if (!connectWithin(fd, (struct sockaddr *) &addr, sizeof(addr),
+				abandoned)) {
+			close(fd);
+			return -1;
+		}
+		return fd;
+	}
+
+	std::string host, port;
+	if (!splitAddress(address, host, port)) {
+		return -1;
+	}
+	struct addrinfo hints;
+	std::memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	struct addrinfo *result;
+	if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0) {
+		return -1;
+	}
+	int fd = -1;
+	for (struct addrinfo *ai = result; ai != NULL; ai = ai->ai_next) {
+		fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC | SOCK_NONBLOCK,
+				ai->ai_protocol);
+		if (fd == -1) {
+			continue;
+		}
+		if (connectWithin(fd, ai->ai_addr, ai->ai_addrlen, abandoned)) {
+			break;
+		}
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(result);
+	if (fd != -1) {
+		// Requests and exit frames are small, do not delay them
+		const int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	}
+	return fd;
+}
+
+int listenRemote(const char *address, bool all_interfaces) {
+	const int BACKLOG = 128;
+	if (isUnix(address)) {
+		struct sockaddr_un addr;
+		if (!unixAddress(address, addr)) {
+			return -1;
+		}
+		const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (fd == -1) {
+			return -1;
+		}
+		// Replace the socket of a previous daemon. Whoever may connect may
+		// run anything, so create the socket accessible to the owner only.
+		unlink(addr.sun_path);
+		const mode_t mask = umask(0177);
+		const int bound = bind(fd, (struct sockaddr *) &addr, sizeof(addr));
+		umask(mask);
+		if (bound == -1 || listen(fd, BACKLOG) == -1) {
+			close(fd);
+			return -1;
+		}
+		return fd;
+	}
+
+	std::string host, port;
+	if (!splitAddress(address, host, port)) {
+		return -1;
+	}
+	struct addrinfo hints;
+	std::memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	// Without a host, getaddrinfo() returns the loopback addresses, or the
+	// wildcard addresses with AI_PASSIVE
+	const bool wildcard = host == "*";
+	if (wildcard) {
+		hints.ai_flags = AI_PASSIVE;
+	}
+	struct addrinfo *result;
+	if (getaddrinfo(host.empty() || wildcard ? NULL : host.c_str(),
+			port.c_str(), &hints, &result) != 0) {
+		return -1;
+	}
+	int fd = -1;
+	bool refused = false;
+	for (struct addrinfo *ai = result; ai != NULL; ai = ai->ai_next) {
+		if (!all_interfaces && !isLoopback(ai->ai_addr)) {
+			refused = true;
+			continue;
+		}
+		fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC,
+				ai->ai_protocol);
+		if (fd == -1) {
+			continue;
+		}
+		const int one = 1;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0
+				&& listen(fd, BACKLOG) == 0) {
+			break;
+		}
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(result);
+	if (fd == -1 && refused) {
+		errno = EACCES;
+	}
+	return fd;
+}
+
+bool writeSpawnRequest(int fd, const std::vector<ChildParams> &stages,
+		const char *secret) {
+	if (stages.size() > REMOTE_MAX_STAGES) {
+		return false;
+	}
+	if (secret == (const char *) NULL) {
+		secret = "";
+	}
+	if (std::strlen(secret) > REMOTE_MAX_SECRET) {
+		return false;
+	}
+	size_t string_bytes = 0;
+	std::string request(MAGIC, sizeof(MAGIC));
+	putString(request, secret);
+	putInt(request, stages.size());
+	for (size_t i = 0; i < stages.size(); i++) {
+		putInt(request, stages[i].getVmLimit());
+		putInt(request, stages[i].getCpuLimit());
+		putString(request, stages[i].getChildProc());
+		string_bytes += std::strlen(stages[i].getChildProc());
+		const char * const *argv = stages[i].getArgv();
+		unsigned int argc = 0;
+		while (argv[argc] != NULL) {
+			argc++;
+		}
+		if (argc > REMOTE_MAX_ARGS) {
+			return false;
+		}
+		putInt(request, argc);
+		for (unsigned int j = 0; j < argc; j++) {
+			putString(request, argv[j]);
+			string_bytes += std::strlen(argv[j]);
+		}
+	}
+	return string_bytes <= REMOTE_MAX_REQUEST
+			&& writeAll(fd, request.data(), request.size());
+}
+
+bool RemoteJob::read(int fd, const std::string &secret) {
+	char magic[sizeof(MAGIC)];
+	if (!readAll(fd, magic, sizeof(magic))
+			|| std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+		return false;
+	}
+	std::string sent;
+	unsigned int secret_space = REMOTE_MAX_SECRET;
+	if (!readString(fd, sent, secret_space)
+			|| !sameSecret(sent, secret)) {
+		return false;
+	}
+	unsigned int stage_count;
+	if (!readInt(fd, stage_count) || stage_count == 0
+			|| stage_count > REMOTE_MAX_STAGES) {
+		return false;
+	}
+	unsigned int remaining = REMOTE_MAX_REQUEST;
+	procs.resize(stage_count);
+	args.resize(stage_count);
+	vm_limits.resize(stage_count);
+	cpu_limits.resize(stage_count);
+	for (unsigned int i = 0; i < stage_count; i++) {
+		unsigned int argc;
+		if (!readInt(fd, vm_limits[i]) || !readInt(fd, cpu_limits[i])
+				|| !readString(fd, procs[i], remaining) || !readInt(fd, argc)
+				|| argc > REMOTE_MAX_ARGS) {
+			return false;
+		}
+		args[i].resize(argc);
+		for (unsigned int j = 0; j < argc; j++) {
+			if (!readString(fd, args[i][j], remaining)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+std::vector<ChildParams> RemoteJob::stages() {
+	argvs.assign(procs.size(), std::vector<const char *>());
+	std::vector<ChildParams> result;
+	for (size_t i = 0; i < procs.size(); i++) {
+		for (size_t j = 0; j < args[i].size(); j++) {
+			argvs[i].push_back(args[i][j].c_str());
+		}
+		argvs[i].push_back((const char *) NULL);
+		result.push_back(ChildParams(procs[i].c_str(), &argvs[i][0],
+				vm_limits[i], cpu_limits[i]));
+	}
+	return result;
+}
+
+bool writeFrame(int fd, char type, const char *data, size_t length) {
+	std::string header(1, type);
+	putInt(header, length);
+	return writeAll(fd, header.data(), header.size())
+			&& (length == 0 || writeAll(fd, data, length));
+}
+
+std::string encodeExit(const std::vector<RemoteStatus> &statuses) {
+	std::string payload;
+	for (size_t i = 0; i < statuses.size(); i++) {
+		putInt(payload, statuses[i].kind);
+		putInt(payload, statuses[i].value);
+	}
+	return payload;
+}
+
+bool decodeExit(const std::string &payload,
+		std::vector<RemoteStatus> &statuses) {
+	const size_t STATUS_SIZE = 2 * sizeof(uint32_t);
+	if (payload.size() % STATUS_SIZE != 0) {
+		return false;
+	}
+	statuses.clear();
+	for (size_t i = 0; i < payload.size(); i += STATUS_SIZE) {
+		uint32_t net[2];
+		std::memcpy(net, payload.data() + i, STATUS_SIZE);
+		RemoteStatus status;
+		status.kind = ntohl(net[0]);
+		status.value = ntohl(net[1]);
+		statuses.push_back(status);
+	}
+	return true;
+}
+
+bool readFrame(int fd, char &type, std::string &payload) {
+	unsigned int length;
+	if (!readAll(fd, &type, 1) || !readInt(fd, length)
+			|| length > REMOTE_MAX_FRAME) {
+		return false;
+	}
+	payload.resize(length);
+	return length == 0 || readAll(fd, &payload[0], length);
+}
+
+} /* namespace quickly */
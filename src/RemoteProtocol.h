@@ -0,0 +1,141 @@
+/*
+ * Copyright 2014 Nedim Srndic, University of Tuebingen
+ *
+ * This file is part of libquickly.
+
+ * libquickly is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libquickly is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libquickly.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * RemoteProtocol.h
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef QUICKLY_REMOTEPROTOCOL_H_
+#define QUICKLY_REMOTEPROTOCOL_H_
+
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+
+#include "ChildParams.h"
+
+namespace quickly {
+
+/*
+ * The protocol between a ThreadPool and a quickly-worker daemon. The pool
+ * opens one connection per job and sends a spawn request: the magic
+ * "QKW1", the secret shared with the daemon (empty if it has none), the
+ * number of stages, and for every stage its limits, executable and
+ * arguments. Integers are 32 bits in network byte order and strings are
+ * prefixed by their length.
+ *
+ * The daemon answers with a stream of frames, each a type byte followed by
+ * the length and the payload: output frames carrying the standard output of
+ * the last stage as it is read, then a single exit frame carrying two
+ * integers per stage (see REMOTE_EXITED and REMOTE_SIGNALED), or an error
+ * frame carrying a message if the job could not be started. Closing the
+ * connection early kills the job.
+ *
+ * Addresses are "host:port" for TCP or "unix:path" for unix sockets. To
+ * listen, an empty host (":port") means the loopback interface and "*"
+ * ("*:port") means all interfaces.
+ */
+
+// Frame types
+const char REMOTE_OUTPUT = 'O';
+const char REMOTE_EXIT = 'X';
+const char REMOTE_ERROR = 'E';
+
+// The first integer of a stage's exit status in an exit frame. The second
+// one is the exit code, the signal number or 0, respectively.
+const unsigned int REMOTE_EXITED = 0U;
+const unsigned int REMOTE_SIGNALED = 1U;
+const unsigned int REMOTE_LOST = 2U;
+
+// The exit status of a stage
+struct RemoteStatus {
+	unsigned int kind;
+	unsigned int value;
+};
+
+// The largest frame accepted
+const unsigned int REMOTE_MAX_FRAME = 16U << 20;
+// The most stages, arguments per stage and bytes of strings accepted in a
+// spawn request
+const unsigned int REMOTE_MAX_STAGES = 64U;
+const unsigned int REMOTE_MAX_ARGS = 4096U;
+const unsigned int REMOTE_MAX_REQUEST = 4U << 20;
+// The longest secret accepted
+const unsigned int REMOTE_MAX_SECRET = 1024U;
+// The seconds a pool waits for a daemon to accept a connection
+const unsigned int REMOTE_CONNECT_TIMEOUT = 10U;
+
+/*
+ * A spawn request as received by the daemon, which owns the strings the
+ * stages point to.
+ */
+class RemoteJob {
+private:
+	// The executable of every stage
+	std::vector<std::string> procs;
+	// The arguments of every stage
+	std::vector<std::vector<std::string> > args;
+	// The limits of every stage
+	std::vector<unsigned int> vm_limits;
+	std::vector<unsigned int> cpu_limits;
+	// NULL-terminated argument arrays pointing into args
+	std::vector<std::vector<const char *> > argvs;
+public:
+	// Constructor
+	RemoteJob() :
+			procs(), args(), vm_limits(), cpu_limits(), argvs() {
+	}
+
+	// Reads a spawn request from a connection. Returns false if the
+	// connection failed, the request does not carry the given secret, or it
+	// is malformed or exceeds the limits above.
+	bool read(int fd, const std::string &secret);
+	// Returns the stages of the job, valid as long as this object
+	std::vector<ChildParams> stages();
+};
+
+// Connects to a daemon, giving up after REMOTE_CONNECT_TIMEOUT seconds or as
+// soon as abandoned, if set, returns true. Returns the socket, or -1 on
+// error.
+int connectRemote(const char *address,
+		const boost::function<bool ()> &abandoned = boost::function<bool ()>());
+// Listens for connections of pools. Unless all_interfaces is true, a TCP
+// address must resolve to a loopback address, otherwise errno is set to
+// EACCES. A unix socket is only accessible to its owner. Returns the
+// socket, or -1 on error.
+int listenRemote(const char *address, bool all_interfaces = false);
+
+// Sends a spawn request for the stages of a job, with the secret shared
+// with the daemon, which may be NULL. Returns false if the connection
+// failed or the request exceeds the limits of the daemon.
+bool writeSpawnRequest(int fd, const std::vector<ChildParams> &stages,
+		const char *secret = (const char *) NULL);
+// Sends a frame
+bool writeFrame(int fd, char type, const char *data, size_t length);
+// Encodes the payload of an exit frame
+std::string encodeExit(const std::vector<RemoteStatus> &statuses);
+// Decodes the payload of an exit frame. Returns false if it is malformed.
+bool decodeExit(const std::string &payload,
+		std::vector<RemoteStatus> &statuses);
+// Receives a frame. Returns false if the connection failed or was closed,
+// or the frame is too large.
+bool readFrame(int fd, char &type, std::string &payload);
+
+} /* namespace quickly */
+#endif /* QUICKLY_REMOTEPROTOCOL_H_ */
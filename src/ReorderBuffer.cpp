@@ -0,0 +1,95 @@
+/*
+ * Copyright 2014 Nedim Srndic, University of Tuebingen
+ *
+ * This file is part of libquickly.
+
+ * libquickly is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libquickly is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libquickly.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * ReorderBuffer.cpp
+ *  Created on: Oct 19, 2026
+ */
+
+#include <iostream>
+
+#include "ReorderBuffer.h"
+
+namespace quickly {
+
+void ReorderBuffer::add(const JobOutput &output) {
+	boost::mutex::scoped_lock lock(mutex);
+	pending[output.id] = output;
+	pending_bytes += output.bytes;
+	if (metrics != (Metrics *) NULL) {
+		metrics->reorder_window_depth.set(pending.size());
+	}
+	if (pending.size() > peak_entries) {
+		peak_entries = pending.size();
+	}
+	if (pending_bytes > peak_bytes) {
+		peak_bytes = pending_bytes;
+	}
+
+	// If another thread is delivering, it will pick this output up
+	if (draining) {
+		return;
+	}
+	draining = true;
+	while (!pending.empty() && pending.begin()->first == next) {
+		JobOutput ready = pending.begin()->second;
+		pending.erase(pending.begin());
+		next += ready.count;
+		if (metrics != (Metrics *) NULL) {
+			metrics->reorder_window_depth.set(pending.size());
+		}
+		lock.unlock();
+		deliver(ready);
+		lock.lock();
+		pending_bytes -= ready.bytes;
+	}
+	draining = false;
+}
+
+bool ReorderBuffer::accepts(unsigned int job) {
+	boost::mutex::scoped_lock lock(mutex);
+	// The next job to deliver can always be started, otherwise nothing
+	// would ever leave the buffer
+	if (job == next) {
+		return true;
+	}
+	if (max_entries != 0 && job - next >= max_entries) {
+		return false;
+	}
+	return max_bytes == 0 || pending_bytes < max_bytes;
+}
+
+void ReorderBuffer::deliver(const JobOutput &output) {
+	if (!output.buffer) { // Failed job
+		return;
+	}
+	if (consumers != (ConsumerStage *) NULL) {
+		consumers->push(output);
+		return;
+	}
+	const bool ok = runDataActions(data_action, splitter, output.id,
+			output.count, *output.buffer, cancellation, metrics);
+	if (!ok) {
+		std::cerr << "ReorderBuffer: could not split the output of a batch"
+				<< std::endl;
+	}
+	if (log != (DeliveryLog *) NULL) {
+		log->record(output.id, output.count, ok);
+	}
+}
+
+} /* namespace quickly */
@@ -0,0 +1,123 @@
+/*
+ * Copyright 2014 Nedim Srndic, University of Tuebingen
+ *
+ * This file is part of libquickly.
+
+ * libquickly is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libquickly is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libquickly.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * ReorderBuffer.h
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef QUICKLY_REORDERBUFFER_H_
+#define QUICKLY_REORDERBUFFER_H_
+
+#include <cstddef>	// size_t
+#include <map>
+
+#include <boost/thread.hpp>
+
+#include "ConsumerStage.h"
+#include "DataAction.h"
+
+namespace quickly {
+
+/*
+ * Delivers job outputs to the data actions in job ID order. Outputs which
+ * arrive early wait in the buffer until all jobs before them have been
+ * delivered. The scheduler asks accepts() before starting a job, which keeps
+ * the buffer within its limits.
+ *
+ * Delivery happens in the thread which adds the missing output, one output
+ * at a time, either by running the data actions or by pushing the output to
+ * a consumer stage.
+ */
+class ReorderBuffer {
+private:
+	// An action to perform on the results obtained from the child processes
+	DataActionBase *data_action;
+	// Splits the output of a batch into per-job outputs, may be NULL
+	OutputSplitter *splitter;
+	// Runs the data actions on other threads, may be NULL
+	ConsumerStage *consumers;
+	// Cancelled by data actions whose verdict is STOP, may be NULL
+	Cancellation *cancellation;
+	// Live metrics of the pool, may be NULL
+	Metrics *metrics;
+	// Records whether the data actions of every output ran, unless they run
+	// on the consumers, may be NULL
+	DeliveryLog *log;
+	// Maximum span of job IDs between the next undelivered job and the next
+	// job to start, 0 for no limit
+	unsigned int max_entries;
+	// Maximum number of buffered bytes, 0 for no limit
+	size_t max_bytes;
+	// The ID of the next job to deliver
+	unsigned int next;
+	// Outputs which arrived out of order, by job ID
+	std::map<unsigned int, JobOutput> pending;
+	// The total size of the pending outputs
+	size_t pending_bytes;
+	// The peak number of pending outputs
+	unsigned int peak_entries;
+	// The peak size of the pending outputs
+	size_t peak_bytes;
+	// Set while a thread is delivering outputs
+	bool draining;
+	// Protects all of the above
+	boost::mutex mutex;
+
+	// Delivers a single output
+	void deliver(const JobOutput &output);
+
+	// Noncopyable
+	ReorderBuffer(const ReorderBuffer &);
+	ReorderBuffer &operator =(const ReorderBuffer &);
+public:
+	// Constructor
+	ReorderBuffer(DataActionBase *data_action, OutputSplitter *splitter,
+			ConsumerStage *consumers, unsigned int max_entries,
+			size_t max_bytes, Cancellation *cancellation = (Cancellation *) NULL,
+			Metrics *metrics = (Metrics *) NULL,
+			DeliveryLog *log = (DeliveryLog *) NULL) :
+			data_action(data_action), splitter(splitter), consumers(consumers),
+			cancellation(cancellation), metrics(metrics), log(log),
+			max_entries(max_entries), max_bytes(max_bytes), next(0U),
+			pending(), pending_bytes(0), peak_entries(0U), peak_bytes(0),
+			draining(false) {
+	}
+
+	/*
+	 * Adds the output of a job. An output without a buffer marks jobs which
+	 * failed; they are skipped.
+	 */
+	void add(const JobOutput &output);
+
+	// Returns true if the job with the given ID may be started
+	bool accepts(unsigned int job);
+
+	// Returns the peak number of outputs waiting in the buffer
+	unsigned int getPeakEntries() {
+		boost::mutex::scoped_lock lock(mutex);
+		return peak_entries;
+	}
+	// Returns the peak number of bytes waiting in the buffer
+	size_t getPeakBytes() {
+		boost::mutex::scoped_lock lock(mutex);
+		return peak_bytes;
+	}
+};
+
+} /* namespace quickly */
+#endif /* QUICKLY_REORDERBUFFER_H_ */
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2014 Nedim Srndic, University of Tuebingen
+ *
+ * This file is part of libquickly.
+
+ * libquickly is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libquickly is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libquickly.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * RunningMedian.h
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef QUICKLY_RUNNINGMEDIAN_H_
+#define QUICKLY_RUNNINGMEDIAN_H_
+
+#include <functional>	// std::greater
+#include <queue>
+#include <vector>
+
+namespace quickly {
+
+/*
+ * The median of a growing set of values, kept up to date in O(log n) per
+ * added value. The lower half of the values is kept in a max-heap, the
+ * upper half in a min-heap, the lower half holding the extra value if the
+ * count is odd.
+ */
+class RunningMedian {
+private:
+	// The lower half of the values, the largest on top
+	std::priority_queue<unsigned long long> lower;
+	// The upper half of the values, the smallest on top
+	std::priority_queue<unsigned long long, std::vector<unsigned long long>,
+			std::greater<unsigned long long> > upper;
+public:
+	// Constructor
+	RunningMedian() :
+			lower(), upper() {
+	}
+	// Adds a value
+	void add(unsigned long long value) {
+		if (lower.empty() || value <= lower.top()) {
+			lower.push(value);
+		} else {
+			upper.push(value);
+		}
+		// Rebalance the halves
+		if (lower.size() > upper.size() + 1) {
+			upper.push(lower.top());
+			lower.pop();
+		} else if (upper.size() > lower.size()) {
+			lower.push(upper.top());
+			upper.pop();
+		}
+	}
+	// Returns true if no value was added
+	bool empty() const {
+		return lower.empty();
+	}
+	// Returns the median, the upper one of the two middle values for an
+	// even count. Must not be called when empty.
+	unsigned long long get() const {
+		return lower.size() > upper.size() ? lower.top() : upper.top();
+	}
+};
+
+} /* namespace quickly */
+#endif /* QUICKLY_RUNNINGMEDIAN_H_ */
@@ -20,90 +20,658 @@
  *  Created on: Apr 29, 2011
  */
 
+#include <cstring>	// strlen()
 #include <iostream>
+#include <sstream>
 
+#include <unistd.h>	// sysconf(), environ
+#include <boost/bind/bind.hpp>
 #include <boost/date_time.hpp>
+#include <boost/make_shared.hpp>
 #include <boost/thread.hpp>
 
 #include "ChildParams.h"
+#include "ConsumerStage.h"
+#include "JobClaims.h"
+#include "Metrics.h"
+#include "RemoteProtocol.h"
+#include "ReorderBuffer.h"
+#include "RunningMedian.h"
 #include "ThreadPool.h"
+#include "Tracer.h"
 
 namespace quickly {
 
+/*
+ * Returns the number of bytes that the arguments argv[from] to argv[to - 1]
+ * take up in a new process image, stopping early at the terminating NULL.
+ */
+static size_t argBytes(const char * const *argv, unsigned int from,
+		unsigned int to) {
+	size_t bytes = 0;
+	unsigned int i = 0;
+	while (i < from && argv[i] != NULL) {
+		i++;
+	}
+	for (; i < to && argv[i] != NULL; i++) {
+		bytes += std::strlen(argv[i]) + 1 + sizeof(char *);
+	}
+	return bytes;
+}
+
+/*
+ * Returns the number of bytes available for the arguments of a child process.
+ * Like xargs, it subtracts the size of the environment and leaves 2 KiB of
+ * headroom.
+ */
+static size_t argSpace() {
+	long arg_max = sysconf(_SC_ARG_MAX);
+	if (arg_max <= 0) {
+		arg_max = _POSIX_ARG_MAX;
+	}
+	size_t used = 2048;
+	for (char **env = environ; *env != NULL; env++) {
+		used += std::strlen(*env) + 1 + sizeof(char *);
+	}
+	return (size_t) arg_max > used ? arg_max - used : 0;
+}
+
+// Returns the number of arguments in argv from index from on
+static unsigned int argCount(const char * const *argv, unsigned int from) {
+	unsigned int i = 0;
+	while (i < from && argv[i] != NULL) {
+		i++;
+	}
+	unsigned int count = 0;
+	for (; argv[i] != NULL; i++) {
+		count++;
+	}
+	return count;
+}
+
+unsigned int ThreadPool::batchSize(unsigned int first_job, size_t arg_space,
+		unsigned int max_args) const {
+	// Hand out half of the remaining jobs, split evenly among the threads.
+	// Batches shrink as the run progresses, so the last ones are short and
+	// the threads finish close together.
+	const unsigned int remaining = child_args.size() - first_job;
+	unsigned int size = (remaining + 2 * slotCount() - 1) / (2 * slotCount());
+	if (batch_max != 0) {
+		size = std::min(size, batch_max);
+	}
+
+	// Stay within ARG_MAX and max_args. A batch always holds at least one
+	// job.
+	size_t bytes = argBytes(child_args[first_job], 0, batch_fixed_args);
+	unsigned int args = std::min(batch_fixed_args,
+			argCount(child_args[first_job], 0));
+	unsigned int count = 0;
+	while (count < size) {
+		size_t job_bytes = argBytes(child_args[first_job + count],
+				batch_fixed_args, (unsigned int) -1);
+		unsigned int job_args = argCount(child_args[first_job + count],
+				batch_fixed_args);
+		if (count > 0 && (bytes + job_bytes + sizeof(char *) > arg_space
+				|| args + job_args > max_args)) {
+			break;
+		}
+		bytes += job_bytes;
+		args += job_args;
+		count++;
+	}
+	return std::max(count, 1U);
+}
+
+void ThreadPool::setDefaults() {
+	VM_limit = 0U;
+	CPU_limit = 0U;
+	verbosity = 0U;
+	batch_fixed_args = 0U;
+	batch_max = 0U;
+	splitter = (OutputSplitter *) NULL;
+	consumer_count = 0U;
+	queue_capacity = 0U;
+	consumer_stats = QueueStats();
+	ordered = false;
+	reorder_entries = 0U;
+	reorder_bytes = 0;
+	budget.reset();
+	trace_path = (const char *) NULL;
+	trace_capacity = 0;
+	metrics.reset(new Metrics);
+	metrics_path = (const char *) NULL;
+	metrics_interval = 1000U;
+	graph.reset();
+	cancellation.reset(new Cancellation);
+	max_failures = 0U;
+	max_successes = 0U;
+	report = RunReport();
+	speculation_factor = 0;
+	remote_addresses.clear();
+	remote_slots.clear();
+	remote_secrets.clear();
+}
+
+void ThreadPool::checkPipelines() {
+	if (pipelines.size() < 1) {
+		throw "ThreadPool: There must be at least one pipeline.";
+	}
+	for (size_t i = 0; i < pipelines.size(); i++) {
+		if (pipelines[i].size() < 1) {
+			throw "ThreadPool: A pipeline must have at least one stage.";
+		}
+	}
+	if (CHILD_COUNT == 0) {
+		CHILD_COUNT = std::max(boost::thread::hardware_concurrency() - 1, 1U);
+	}
+}
+
+void ThreadPool::reportLoop() {
+	const boost::posix_time::time_duration interval =
+			boost::posix_time::milliseconds(metrics_interval);
+	try {
+		while (true) {
+			boost::this_thread::sleep(interval);
+			if (metrics_path != (const char *) NULL) {
+				metrics->writePrometheus(metrics_path);
+			}
+			if (verbosity > 1) {
+				std::cerr << "ThreadPool: " << metrics->jobs_pending.get()
+						<< " jobs pending, " << metrics->threads_running.get()
+						<< " running" << std::endl;
+			}
+		}
+	} catch (boost::thread_interrupted &) {
+		// The run is over
+	}
+}
+
+void ThreadPool::applyPolicies(unsigned int completed, unsigned int failed) {
+	if (((max_successes != 0 && completed >= max_successes)
+			|| (max_failures != 0 && failed >= max_failures))
+			&& cancellation->cancel()) {
+		Tracer::instant("cancel");
+		if (verbosity > 0) {
+			std::cerr << "ThreadPool: cancelling the run after " << completed
+					<< " completed and " << failed << " failed jobs." << std::endl;
+		}
+	}
+}
+
+void ThreadPool::reportDeliveries(DeliveryLog &log,
+		std::vector<bool> &reported, unsigned int &completed,
+		unsigned int &failed) {
+	std::vector<DeliveryLog::Outcome> outcomes;
+	log.take(outcomes);
+	for (size_t k = 0; k < outcomes.size(); k++) {
+		const DeliveryLog::Outcome &outcome = outcomes[k];
+		for (unsigned int j = outcome.id; j < outcome.id + outcome.count; j++) {
+			reported[j] = true;
+			(outcome.ok ? report.completed : report.failed).push_back(j);
+		}
+		if (outcome.ok) {
+			completed += outcome.count;
+		} else {
+			failed += outcome.count;
+			metrics->jobs_failed.add(outcome.count);
+		}
+	}
+}
+
 bool ThreadPool::run() {
 	if (verbosity > 0) {
-		std::cerr << "ThreadPool running with " << CHILD_COUNT << " threads." << std::endl;
+		std::cerr << "ThreadPool running with " << CHILD_COUNT << " threads";
+		if (!remote_addresses.empty()) {
+			std::cerr << " and " << slotCount() - CHILD_COUNT << " remote slots on "
+					<< remote_addresses.size() << " nodes";
+		}
+		std::cerr << "." << std::endl;
+	}
+	// A graph holding only costs does not constrain batched or ordered jobs,
+	// which must start consecutively
+	JobGraph *dag = graph.get();
+	if (dag != (JobGraph *) NULL && !dag->hasDependencies()
+			&& (batch_fixed_args != 0 || ordered)) {
+		dag = (JobGraph *) NULL;
+	}
+	if (dag != (JobGraph *) NULL && !dag->prepare()) {
+		std::cerr << "ThreadPool: The job dependencies contain a cycle." << std::endl;
+		return false;
+	}
+	cancellation->reset();
+	report = RunReport();
+	// Whether each job has been reported
+	std::vector<bool> reported(jobCount(), false);
+	// Number of failed and completed jobs, for the cancellation policies
+	unsigned int jobs_failed = 0;
+	unsigned int jobs_completed = 0;
+	// The local slots come first, followed by the remote ones, interleaved
+	// so that the jobs spread over all nodes
+	const unsigned int SLOT_COUNT = slotCount();
+	std::vector<const char *> slot_remote(CHILD_COUNT, (const char *) NULL);
+	std::vector<const char *> slot_secret(CHILD_COUNT, (const char *) NULL);
+	for (unsigned int k = 0; slot_remote.size() < SLOT_COUNT; k++) {
+		for (size_t n = 0; n < remote_addresses.size(); n++) {
+			if (k < remote_slots[n]) {
+				slot_remote.push_back(remote_addresses[n].c_str());
+				slot_secret.push_back(remote_secrets[n].c_str());
+			}
+		}
 	}
-	// Index of the next job/thread to start
+	// Index of the next job/thread to start, if there are no dependencies
 	unsigned int next_job = 0;
+	// Number of started jobs/threads
+	unsigned int jobs_started = 0;
+	// Number of jobs skipped because a job they depend on failed
+	unsigned int jobs_skipped = 0;
 	// Number of finished jobs/threads
 	unsigned int jobs_done = 0;
+	// Whether new jobs were held back in the previous pass
+	bool was_held = false;
 	// Primitive Boost thread pool
 	boost::thread_group threads;
 	// Pointers to the threads in the thread pool. Needed to reference them
-	boost::thread **tps = new boost::thread*[CHILD_COUNT];
-	for (unsigned int i = 0; i < CHILD_COUNT; i++) {
+	boost::thread **tps = new boost::thread*[SLOT_COUNT];
+	// The first job, the number of jobs and the success of each thread
+	unsigned int *tids = new unsigned int[SLOT_COUNT];
+	unsigned int *tjobs = new unsigned int[SLOT_COUNT];
+	bool *toks = new bool[SLOT_COUNT];
+	// The start time of each thread
+	unsigned long long *tstart = new unsigned long long[SLOT_COUNT];
+	for (unsigned int i = 0; i < SLOT_COUNT; i++) {
 		tps[i] = (boost::thread *) NULL;
+		tids[i] = 0;
+		tjobs[i] = 0;
+		toks[i] = false;
+		tstart[i] = 0ULL;
+	}
+	// The number of running attempts of each job and whether any attempt
+	// succeeded. A job runs more than once only if it is speculated.
+	std::vector<unsigned int> attempts(jobCount(), 0U);
+	std::vector<bool> attempt_ok(jobCount(), false);
+	// Speculative re-execution of stragglers, if enabled: which jobs have
+	// been re-executed and the median duration of the completed jobs
+	JobClaims *claims = (JobClaims *) NULL;
+	std::vector<bool> speculated;
+	RunningMedian median;
+	if (speculation_factor > 0) {
+		claims = new JobClaims(jobCount());
+		speculated.resize(jobCount(), false);
+	}
+	// The timeline of the run, if enabled
+	Tracer *tracer = (Tracer *) NULL;
+	std::vector<TraceBuffer *> slot_tracks(SLOT_COUNT, (TraceBuffer *) NULL);
+	if (trace_path != (const char *) NULL) {
+		tracer = new Tracer(trace_capacity);
+		Tracer::bind(tracer->track("scheduler"));
+		for (unsigned int i = 0; i < SLOT_COUNT; i++) {
+			std::ostringstream name;
+			name << "slot " << i;
+			if (slot_remote[i] != (const char *) NULL) {
+				name << " (" << slot_remote[i] << ")";
+			}
+			slot_tracks[i] = tracer->track(name.str());
+		}
+	}
+	// Writes the metrics and reports progress, if enabled
+	metrics->jobs_pending.set(jobCount());
+	boost::thread *reporter = (boost::thread *) NULL;
+	if (metrics_path != (const char *) NULL || verbosity > 1) {
+		reporter = new boost::thread(boost::bind(&ThreadPool::reportLoop, this));
+	}
+	// Argument space available for batches
+	const size_t arg_space = batch_fixed_args != 0 ? argSpace() : 0;
+	// Batches for daemons also stay within the size of a spawn request
+	const size_t remote_arg_space = std::min(arg_space,
+			(size_t) REMOTE_MAX_REQUEST);
+	// The outcomes of batches whose outputs are delivered after their
+	// thread has finished, since their split may still fail
+	DeliveryLog *log = (DeliveryLog *) NULL;
+	if (batch_fixed_args != 0 && (consumer_count > 0 || ordered)) {
+		log = new DeliveryLog();
+	}
+	// Threads running the data actions, if enabled
+	ConsumerStage *consumers = (ConsumerStage *) NULL;
+	if (consumer_count > 0) {
+		consumers = new ConsumerStage(data_action, splitter, consumer_count,
+				queue_capacity, tracer, metrics.get(), cancellation.get(), log);
+	}
+	// Window for in-order delivery, if enabled
+	ReorderBuffer *reorder = (ReorderBuffer *) NULL;
+	if (ordered) {
+		reorder = new ReorderBuffer(data_action, splitter, consumers,
+				reorder_entries, reorder_bytes, cancellation.get(), metrics.get(),
+				log);
 	}
 	// A cached value for a 0-millisecond thread sleep timeout
 	static const boost::posix_time::time_duration timeout =
 			boost::posix_time::milliseconds(0);
 
 	// Go through all jobs to be done
-	while (jobs_done < child_args.size()) {
+	while (jobs_done < jobCount()) {
+		if (log != (DeliveryLog *) NULL) {
+			reportDeliveries(*log, reported, jobs_completed, jobs_failed);
+			applyPolicies(jobs_completed, jobs_failed);
+		}
+
+		// Once cancelled, only wait for the running jobs
+		const bool cancelled = cancellation->isCancelled();
+		if (cancelled && threads.size() == 0) {
+			break;
+		}
+
+		// The job to start next, jobCount() if none is ready
+		unsigned int job = next_job;
+		if (dag != (JobGraph *) NULL) {
+			job = dag->hasReady() ? dag->top() : jobCount();
+		}
+		if (cancelled) {
+			job = jobCount();
+		}
+
+		// With nothing else to start, re-execute the job which has been
+		// running the longest if it is far behind the median job
+		bool speculative = false;
+		if (claims != (JobClaims *) NULL && job == jobCount() && !cancelled
+				&& threads.size() < SLOT_COUNT && !median.empty()) {
+			const double limit = speculation_factor * median.get();
+			const unsigned long long now = Metrics::now();
+			unsigned long long longest = 0ULL;
+			for (unsigned int i = 0; i < SLOT_COUNT; i++) {
+				const unsigned long long running = now - tstart[i];
+				if (tps[i] != (boost::thread *) NULL && !speculated[tids[i]]
+						&& running > limit && running > longest) {
+					longest = running;
+					job = tids[i];
+					speculative = true;
+				}
+			}
+			if (speculative) {
+				speculated[job] = true;
+				Tracer::instant("speculate", job);
+			}
+		}
+
+		// Hold back new jobs while the reorder window is full or the memory
+		// budget is exhausted
+		const bool held = job < jobCount()
+				&& ((reorder != (ReorderBuffer *) NULL && !reorder->accepts(job))
+						|| (budget && budget->exhausted()));
+		// Trace the start of a hold only, the scheduler may pass here every
+		// millisecond
+		if (held && !was_held) {
+			Tracer::instant("hold");
+		}
+		was_held = held;
+
 		/*
 		 * Start a new job/thread if the number of concurrently running threads
-		 * is not at its maximum and if all jobs have not yet been started
+		 * is not at its maximum and if a job is ready to be started
 		 */
-		if (threads.size() < CHILD_COUNT && next_job < child_args.size()) {
+		if (threads.size() < SLOT_COUNT && job < jobCount() && !held
+				&& (claims == (JobClaims *) NULL || claims->start(job))) {
 			// Find the first unused (NULL) slot in the thread pool
-			unsigned int tokbufi = std::find(tps, tps + CHILD_COUNT,
+			unsigned int tokbufi = std::find(tps, tps + SLOT_COUNT,
 					(boost::thread *) NULL) - tps;
 			// Create a new thread and child process parameters
-			ChildParams params(child_proc, child_args[next_job], VM_limit, CPU_limit);
 			WorkerThread worker;
-			worker.init(params, data_action, next_job);
-			next_job++;
+			if (!pipelines.empty()) {
+				// Apply the pool's limits to stages without limits of their own
+				std::vector<ChildParams> stages(pipelines[job]);
+				for (size_t j = 0; j < stages.size(); j++) {
+					stages[j] = ChildParams(stages[j].getChildProc(),
+							stages[j].getArgv(),
+							stages[j].getVmLimit() != 0U ? stages[j].getVmLimit() : VM_limit,
+							stages[j].getCpuLimit() != 0U ? stages[j].getCpuLimit() : CPU_limit);
+				}
+				worker.initPipeline(stages, data_action, job);
+				tjobs[tokbufi] = 1;
+			} else if (batch_fixed_args == 0) {
+				ChildParams params(child_proc, child_args[job], VM_limit, CPU_limit);
+				worker.init(params, data_action, job);
+				tjobs[tokbufi] = 1;
+			} else {
+				// Concatenate the variable arguments of the whole batch
+				const unsigned int count = slot_remote[tokbufi] == (const char *) NULL
+						? batchSize(job, arg_space, (unsigned int) -1)
+						: batchSize(job, remote_arg_space, REMOTE_MAX_ARGS);
+				boost::shared_ptr<std::vector<const char *> > argv =
+						boost::make_shared<std::vector<const char *> >();
+				const char * const *first = child_args[job];
+				for (unsigned int j = 0; j < batch_fixed_args && first[j] != NULL; j++) {
+					argv->push_back(first[j]);
+				}
+				for (unsigned int b = job; b < job + count; b++) {
+					const char * const *args = child_args[b];
+					unsigned int j = 0;
+					while (j < batch_fixed_args && args[j] != NULL) {
+						j++;
+					}
+					for (; args[j] != NULL; j++) {
+						argv->push_back(args[j]);
+					}
+				}
+				argv->push_back((const char *) NULL);
+				ChildParams params(child_proc, child_args[job], VM_limit, CPU_limit);
+				worker.initBatch(params, data_action, job, count, splitter,
+						argv);
+				tjobs[tokbufi] = count;
+			}
+			tids[tokbufi] = job;
+			tstart[tokbufi] = Metrics::now();
+			attempts[job]++;
+			if (speculative) {
+				metrics->speculative_starts.add(1);
+			} else {
+				jobs_started += tjobs[tokbufi];
+				metrics->jobs_started.add(tjobs[tokbufi]);
+				if (dag != (JobGraph *) NULL) {
+					dag->pop();
+				} else {
+					next_job += tjobs[tokbufi];
+				}
+			}
+			worker.setConsumers(consumers);
+			worker.setReorderBuffer(reorder);
+			worker.setMemoryBudget(budget.get());
+			worker.setTrace(slot_tracks[tokbufi]);
+			worker.setMetrics(metrics.get());
+			worker.setCancellation(cancellation.get());
+			worker.setClaims(claims);
+			worker.setRemote(slot_remote[tokbufi], slot_secret[tokbufi]);
+			worker.setSuccess(&toks[tokbufi]);
+			Tracer::instant("start", job);
+			metrics->jobs_pending.set(jobCount() - jobs_started - jobs_skipped);
 			// Start the new thread
 			boost::thread *thread = threads.create_thread(worker);
 			tps[tokbufi] = thread;
+			metrics->threads_running.set(threads.size());
 		}
 
 		/*
 		 * Wait for a thread to stop if the maximum number of concurrently
 		 * running threads has been reached, or there are no more
-		 * jobs/threads to start
+		 * jobs/threads to start, or new jobs are held back
 		 */
-		if (threads.size() == CHILD_COUNT || next_job == child_args.size()) {
+		if (threads.size() == SLOT_COUNT || job == jobCount() || held) {
+			// Only the consumers can free memory while nothing runs
+			if (threads.size() == 0) {
+				static const boost::posix_time::time_duration held_timeout =
+						boost::posix_time::milliseconds(1);
+				boost::this_thread::sleep(held_timeout);
+				continue;
+			}
+
 			// Poll all the threads in the pool until at least one thread
-			// voluntarily finishes
+			// voluntarily finishes. When speculating, look for stragglers
+			// again every 10 ms.
+			Tracer::begin("wait");
+			const unsigned long long wait_start = Metrics::now();
+			bool reaped = false;
 			unsigned int i = 0;
-			for (;; i = (i + 1) % CHILD_COUNT) {
+			for (;; i = (i + 1) % SLOT_COUNT) {
 				if (tps[i] != (boost::thread *) NULL
 						&& tps[i]->timed_join(timeout)) {
+					reaped = true;
+					break;
+				}
+				if (claims != (JobClaims *) NULL && threads.size() < SLOT_COUNT
+						&& i == SLOT_COUNT - 1
+						&& Metrics::now() - wait_start > 10000ULL) {
 					break;
 				}
 			}
+			Tracer::end("wait");
+			if (!reaped) {
+				continue;
+			}
+			Tracer::instant("reap");
 
 			// Deallocate the finished thread
 			threads.remove_thread(tps[i]);
 			delete tps[i];
 			tps[i] = (boost::thread *) NULL;
-			jobs_done++;
-			unsigned int jobs_remaining = child_args.size() - jobs_done;
-			if (verbosity > 1) {
-				if (jobs_remaining % 100 == 0 || jobs_remaining < 100) {
-					std::cerr << child_args.size() - jobs_done << std::endl;
+			metrics->threads_running.set(threads.size());
+
+			// A job is done when its last attempt has finished
+			attempts[tids[i]]--;
+			if (toks[i]) {
+				attempt_ok[tids[i]] = true;
+				if (claims != (JobClaims *) NULL) {
+					median.add(Metrics::now() - tstart[i]);
+				}
+			}
+			if (attempts[tids[i]] > 0) {
+				continue;
+			}
+			const bool ok = attempt_ok[tids[i]];
+			jobs_done += tjobs[i];
+			// Delivered batches are reported once their data actions ran
+			if (ok && log != (DeliveryLog *) NULL) {
+				continue;
+			}
+
+			// Jobs which fail after a cancellation were most likely killed
+			const bool killed = !ok && cancellation->isCancelled();
+			for (unsigned int j = tids[i]; j < tids[i] + tjobs[i]; j++) {
+				reported[j] = true;
+				(ok ? report.completed
+						: killed ? report.cancelled : report.failed).push_back(j);
+			}
+			if (ok) {
+				jobs_completed += tjobs[i];
+			} else if (!killed) {
+				jobs_failed += tjobs[i];
+				metrics->jobs_failed.add(tjobs[i]);
+			}
+			applyPolicies(jobs_completed, jobs_failed);
+
+			// Release or skip the jobs depending on the finished one
+			if (dag != (JobGraph *) NULL) {
+				std::vector<unsigned int> skipped;
+				dag->finished(tids[i], ok, skipped);
+				if (!skipped.empty()) {
+					if (verbosity > 0) {
+						std::cerr << "ThreadPool: job " << tids[i]
+								<< (killed ? " was cancelled" : " failed") << ", skipping "
+								<< skipped.size() << " jobs depending on it." << std::endl;
+					}
+					// The jobs depending on a killed one share its fate
+					for (size_t j = 0; j < skipped.size(); j++) {
+						reported[skipped[j]] = true;
+						(killed ? report.cancelled : report.failed).push_back(skipped[j]);
+					}
+					jobs_done += skipped.size();
+					jobs_skipped += skipped.size();
+					if (!killed) {
+						metrics->jobs_failed.add(skipped.size());
+					}
+					metrics->jobs_pending.set(jobCount() - jobs_started - jobs_skipped);
 				}
 			}
 		}
 	}
 
+	if (reorder != (ReorderBuffer *) NULL) {
+		if (verbosity > 0) {
+			std::cerr << "ThreadPool reorder window: peak " << reorder->getPeakEntries()
+					<< " outputs, " << reorder->getPeakBytes() << " bytes" << std::endl;
+		}
+		delete reorder;
+	}
+
+	// Wait for the consumers to process the remaining outputs
+	if (consumers != (ConsumerStage *) NULL) {
+		consumers->finish();
+		consumer_stats = consumers->getStats();
+		delete consumers;
+		if (verbosity > 0) {
+			std::cerr << "ThreadPool consumer queue: peak depth "
+					<< consumer_stats.max_depth << ", " << consumer_stats.push_stalls
+					<< " worker stalls (" << consumer_stats.push_stall_us / 1000
+					<< " ms)" << std::endl;
+		}
+	}
+
+	// Report the batches delivered last
+	if (log != (DeliveryLog *) NULL) {
+		reportDeliveries(*log, reported, jobs_completed, jobs_failed);
+		delete log;
+	}
+
+	// Jobs which never started were cancelled
+	report.was_cancelled = cancellation->isCancelled();
+	for (unsigned int j = 0; j < jobCount(); j++) {
+		if (!reported[j]) {
+			report.cancelled.push_back(j);
+		}
+	}
+	std::sort(report.completed.begin(), report.completed.end());
+	std::sort(report.failed.begin(), report.failed.end());
+	std::sort(report.cancelled.begin(), report.cancelled.end());
+
+	if (reporter != (boost::thread *) NULL) {
+		reporter->interrupt();
+		reporter->join();
+		delete reporter;
+		if (metrics_path != (const char *) NULL
+				&& !metrics->writePrometheus(metrics_path)) {
+			std::cerr << "ThreadPool: could not write the metrics to "
+					<< metrics_path << std::endl;
+		}
+	}
+
+	if (tracer != (Tracer *) NULL) {
+		Tracer::bind((TraceBuffer *) NULL);
+		if (!tracer->write(trace_path)) {
+			std::cerr << "ThreadPool: could not write the trace to " << trace_path
+					<< std::endl;
+		}
+		delete tracer;
+	}
+
+	if (budget && verbosity > 0) {
+		std::cerr << "ThreadPool buffered output: peak " << budget->getPeak()
+				<< " bytes" << std::endl;
+	}
+
 	// Deallocate memory
 	delete[] tps;
+	delete[] tids;
+	delete[] tjobs;
+	delete[] toks;
+	delete[] tstart;
+	delete claims;
 
-	if (verbosity > 2) {
-		std::cerr << "ThreadPool finished." << std::endl;
+	if (verbosity > 0) {
+		std::cerr << "ThreadPool finished: " << metrics->jobs_finished.get()
+				<< " jobs finished, " << metrics->jobs_failed.get() << " failed."
+				<< std::endl;
+		if (report.was_cancelled) {
+			std::cerr << "ThreadPool cancelled: " << report.completed.size()
+					<< " jobs completed, " << report.cancelled.size()
+					<< " cancelled." << std::endl;
+		}
 	}
 	return true;
 }
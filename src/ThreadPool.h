@@ -24,12 +24,43 @@
 #define QUICKLY_THREADPOOL_H_
 
 #include <algorithm> // max()
+#include <cstring>	// strlen()
+#include <string>
 #include <vector>
 
+#include <boost/shared_ptr.hpp>
+
+#include "BoundedQueue.h"
+#include "Cancellation.h"
 #include "DataAction.h"
+#include "DeliveryLog.h"
+#include "JobGraph.h"
+#include "MemoryBudget.h"
+#include "Metrics.h"
+#include "RemoteProtocol.h"
 #include "WorkerThread.h"
 
 namespace quickly {
+/*!
+ * \brief The outcome of the jobs of a ThreadPool run, in job ID order.
+ */
+struct RunReport {
+	//! Whether the run was cancelled before all jobs had finished.
+	bool was_cancelled;
+	//! Jobs whose child processes exited normally.
+	std::vector<unsigned int> completed;
+	//! Jobs whose child processes failed, and jobs skipped because a job
+	//! they depend on failed.
+	std::vector<unsigned int> failed;
+	//! Jobs which were killed or never started because the run was cancelled.
+	std::vector<unsigned int> cancelled;
+
+	//! Constructor.
+	RunReport() :
+			was_cancelled(false), completed(), failed(), cancelled() {
+	}
+};
+
 /*!
  * \brief A class representing a pool of worker threads.
  *
@@ -41,6 +72,8 @@ private:
 	const char *child_proc;
 	// Arguments to the child processes
 	std::vector<const char * const *> child_args;
+	// The stages of every job, if the jobs are pipelines
+	std::vector<std::vector<ChildParams> > pipelines;
 	// An action to perform on the results obtained from the child processes
 	DataActionBase *data_action;
 	// Maximum number of processes to run concurrently
@@ -51,6 +84,101 @@ private:
 	unsigned int CPU_limit;
 	// Level of verbosity
 	unsigned int verbosity;
+	// Number of leading arguments shared by all jobs of a batch, 0 if
+	// batching is disabled
+	unsigned int batch_fixed_args;
+	// Maximum number of jobs per batch, 0 for no limit other than ARG_MAX
+	unsigned int batch_max;
+	// Splits the output of a batch into per-job outputs
+	OutputSplitter *splitter;
+	// Number of threads running data actions, 0 to run them in the worker
+	// threads
+	unsigned int consumer_count;
+	// Maximum number of outputs waiting for a consumer thread
+	unsigned int queue_capacity;
+	// Statistics of the consumer queue of the last run
+	QueueStats consumer_stats;
+	// Whether to deliver the outputs in job ID order
+	bool ordered;
+	// Maximum number of job IDs the reorder window spans, 0 for no limit
+	unsigned int reorder_entries;
+	// Maximum number of bytes held in the reorder window, 0 for no limit
+	size_t reorder_bytes;
+	// Limits the memory used by buffered child output, NULL for no limit
+	boost::shared_ptr<MemoryBudget> budget;
+	// Where to write the trace of a run, NULL if not tracing
+	const char *trace_path;
+	// The number of trace events kept per thread
+	size_t trace_capacity;
+	// Live metrics, shared by all copies of the pool
+	boost::shared_ptr<Metrics> metrics;
+	// Where to write the metrics periodically, NULL if not writing them
+	const char *metrics_path;
+	// The interval between two writes of the metrics, in milliseconds
+	unsigned int metrics_interval;
+	// The dependencies between the jobs, NULL if there are none
+	boost::shared_ptr<JobGraph> graph;
+	// Cancels the current run, shared by all copies of the pool
+	boost::shared_ptr<Cancellation> cancellation;
+	// Number of failed jobs after which the run is cancelled, 0 for no limit
+	unsigned int max_failures;
+	// Number of completed jobs after which the run is cancelled, 0 for no
+	// limit
+	unsigned int max_successes;
+	// The outcome of the jobs of the last run
+	RunReport report;
+	// How many times longer than the median job a job must run to be
+	// re-executed speculatively, 0 to disable speculation
+	double speculation_factor;
+	// The addresses of the quickly-worker daemons which run jobs
+	std::vector<std::string> remote_addresses;
+	// The number of jobs each daemon runs concurrently
+	std::vector<unsigned int> remote_slots;
+	// The secret shared with each daemon, empty if none
+	std::vector<std::string> remote_secrets;
+
+	// Sets all options to their defaults, shared by the constructors
+	void setDefaults();
+	// Checks the pipelines and sets the default child count, shared by the
+	// constructors for pipelines
+	void checkPipelines();
+	// Turns single child processes into pipelines of one stage
+	static std::vector<std::vector<ChildParams> > singleStages(
+			const std::vector<ChildParams> &jobs) {
+		std::vector<std::vector<ChildParams> > pipelines;
+		for (size_t i = 0; i < jobs.size(); i++) {
+			pipelines.push_back(std::vector<ChildParams>(1, jobs[i]));
+		}
+		return pipelines;
+	}
+	// Returns the number of jobs
+	unsigned int jobCount() const {
+		return pipelines.empty() ? child_args.size() : pipelines.size();
+	}
+	// Returns the number of jobs which run concurrently, locally and on the
+	// daemons
+	unsigned int slotCount() const {
+		unsigned int slots = CHILD_COUNT;
+		for (size_t i = 0; i < remote_slots.size(); i++) {
+			slots += remote_slots[i];
+		}
+		return slots;
+	}
+	// Periodically writes the metrics and reports progress during a run
+	void reportLoop();
+	// Cancels the run if the cancellation policies say so, given the
+	// numbers of completed and failed jobs
+	void applyPolicies(unsigned int completed, unsigned int failed);
+	// Reports the batches whose outputs were delivered since the last call,
+	// marking their jobs in reported and adding them to completed or failed
+	void reportDeliveries(DeliveryLog &log, std::vector<bool> &reported,
+			unsigned int &completed, unsigned int &failed);
+
+	// Returns the number of jobs to put into the batch starting at
+	// first_job, given the number of bytes available for arguments and the
+	// most arguments a child may get
+	unsigned int batchSize(unsigned int first_job, size_t arg_space,
+			unsigned int max_args) const;
 public:
 	/*!
 	 * \brief Constructor
@@ -64,8 +192,8 @@ public:
 			const std::vector<const char * const *> &child_args,
 			DataActionBase *data_action, unsigned int child_count = 0) :
 			child_proc(child_proc), child_args(child_args),
-			data_action(data_action), CHILD_COUNT(child_count),
-			VM_limit(0U), CPU_limit(0U), verbosity(0U) {
+			data_action(data_action), CHILD_COUNT(child_count) {
+		setDefaults();
 		if (this->child_proc == 0) {
 			throw "ThreadPool: Child executable name not set.";
 		}
@@ -78,12 +206,158 @@ public:
 		}
 	}
 
+	/*!
+	 * \brief Constructor for jobs which are pipelines of child processes.
+	 *
+	 * Every job is a list of stages. The standard output of each stage is
+	 * connected to the standard input of the next one by a pipe, so the data
+	 * flows from child to child without passing through this process. Only
+	 * the output of the last stage is passed to the data action. A job fails
+	 * if any stage is killed, except for an earlier stage killed by SIGPIPE
+	 * because a later one stopped reading.
+	 *
+	 * The executable names and argument arrays referenced by the stages must
+	 * stay valid until run() returns. The limits set with setVmLimit() and
+	 * setCpuLimit() apply to stages which have no limits of their own.
+	 *
+	 * \param pipelines the stages of every job, in order.
+	 * \param data_action an instance of a class inheriting DataActionBase which contains the code that will process the results returned by the last stages.
+	 * \param child_count the maximum number of concurrently running jobs. If 0 (default), it will be set to the number one less than the number of execution pipelines (CPU cores or HyperThreading units) available on the machine.
+	 */
+	ThreadPool(const std::vector<std::vector<ChildParams> > &pipelines,
+			DataActionBase *data_action, unsigned int child_count = 0) :
+			child_proc((const char *) NULL), child_args(), pipelines(pipelines),
+			data_action(data_action), CHILD_COUNT(child_count) {
+		setDefaults();
+		checkPipelines();
+	}
+
+	/*!
+	 * \brief Constructor for jobs which run different executables.
+	 *
+	 * Every job has its own executable, arguments and limits. Combined with
+	 * addDependency(), this describes a graph of heterogeneous jobs. The
+	 * executable names and argument arrays must stay valid until run()
+	 * returns. The limits set with setVmLimit() and setCpuLimit() apply to
+	 * jobs which have no limits of their own.
+	 *
+	 * \param jobs the parameters of every job.
+	 * \param data_action an instance of a class inheriting DataActionBase which contains the code that will process the results returned by the child executables.
+	 * \param child_count the maximum number of concurrent threads/executables to run. If 0 (default), it will be set to the number one less than the number of execution pipelines (CPU cores or HyperThreading units) available on the machine.
+	 */
+	ThreadPool(const std::vector<ChildParams> &jobs,
+			DataActionBase *data_action, unsigned int child_count = 0) :
+			child_proc((const char *) NULL), child_args(),
+			pipelines(singleStages(jobs)), data_action(data_action),
+			CHILD_COUNT(child_count) {
+		setDefaults();
+		checkPipelines();
+	}
+
 	/*!
 	 * \brief Runs the thread pool until all threads finish. Returns true on success,
 	 * otherwise false.
+	 *
+	 * A cancelled run also returns true; see getReport() for which jobs ran.
 	 */
 	bool run();
 
+	/*!
+	 * \brief Cancels the current run.
+	 *
+	 * No new jobs are started and the children of all running jobs are
+	 * killed with SIGKILL. Every job runs in a process group of its own, so
+	 * any processes its children started are killed as well. run() returns
+	 * as soon as the killed jobs have been reaped. Outputs of jobs which finished before are still
+	 * delivered. May be called from any thread while run() is running; it
+	 * has no effect on later runs.
+	 *
+	 * A run can also be cancelled from a data action, by returning STOP from
+	 * DataActionBase::verdict().
+	 */
+	void cancel() {
+		cancellation->cancel();
+	}
+	/*!
+	 * \brief Cancels a run once a number of jobs have failed.
+	 *
+	 * Jobs killed by the cancellation and jobs skipped because of a failed
+	 * dependency do not count.
+	 *
+	 * \param failures the number of failed jobs. If 0, not limited.
+	 */
+	void setMaxFailures(unsigned int failures) {
+		max_failures = failures;
+	}
+	/*!
+	 * \brief Cancels a run once a number of jobs have completed, e.g. after
+	 * the first success when any one result will do.
+	 *
+	 * \param successes the number of completed jobs. If 0, not limited.
+	 */
+	void setMaxSuccesses(unsigned int successes) {
+		max_successes = successes;
+	}
+	/*!
+	 * \brief Re-executes straggler jobs at the tail of a run.
+	 *
+	 * Once no job is waiting to be started and a thread slot is idle, the
+	 * job which has been running the longest is started a second time if it
+	 * has run for more than factor times the median duration of the jobs
+	 * completed so far. This helps when children are slow because of a busy
+	 * core rather than because of their input. The first attempt to succeed
+	 * delivers its output, so doFull() is still called once per job, and the
+	 * other attempt is killed. A job fails only if both attempts fail. The
+	 * children must not have side effects other than their output.
+	 *
+	 * \param factor how many times longer than the median a job must run. If
+	 * 0, jobs are never re-executed.
+	 */
+	void setSpeculation(double factor) {
+		if (batch_fixed_args != 0 && factor > 0) {
+			throw "ThreadPool: Batches cannot be re-executed speculatively.";
+		}
+		speculation_factor = factor;
+	}
+	/*!
+	 * \brief Runs jobs on a quickly-worker daemon in addition to the local
+	 * threads.
+	 *
+	 * The pool sends a job's executable, arguments and limits to the daemon,
+	 * which runs the child process(es) and streams their output back, so
+	 * the same data action processes local and remote jobs. The executables
+	 * must exist at the same paths on the daemon's host. Jobs are spread
+	 * over all daemons. A job whose daemon cannot be reached, or which
+	 * rejects the secret, fails.
+	 *
+	 * The secret is sent in the clear, so it only keeps other users of a
+	 * trusted network from running jobs on the daemon.
+	 *
+	 * \param address "host:port" for TCP or "unix:path" for a unix socket.
+	 * \param slots the maximum number of jobs to run on the daemon
+	 * concurrently, e.g. its number of cores.
+	 * \param secret the secret the daemon was started with (see its
+	 * --secret-file option), or NULL if it has none.
+	 */
+	void addRemoteNode(const char *address, unsigned int slots,
+			const char *secret = (const char *) NULL) {
+		if (address == 0) {
+			throw "ThreadPool: Remote node address not set.";
+		}
+		if (secret != 0 && std::strlen(secret) > REMOTE_MAX_SECRET) {
+			throw "ThreadPool: Remote node secret too long.";
+		}
+		remote_addresses.push_back(address);
+		remote_slots.push_back(slots);
+		remote_secrets.push_back(secret != 0 ? secret : "");
+	}
+	/*!
+	 * \brief Returns the outcome of the jobs of the last run.
+	 */
+	const RunReport &getReport() const {
+		return report;
+	}
+
 	/*!
 	 * \brief Limits the amount of virtual memory every child process can use.
 	 *
@@ -103,11 +377,223 @@ public:
 	/*!
 	 * Set the output verbosity level.
 	 *
+	 * Level 1 prints a summary at the end of a run, level 2 also prints the
+	 * progress once per metrics interval (see setMetricsFile()).
+	 *
 	 * @param verbosity the new verbosity level.
 	 */
 	void setVerbosity(unsigned int verbosity) {
 		this->verbosity = verbosity;
 	}
+	/*!
+	 * \brief Enables xargs-style batching of consecutive jobs.
+	 *
+	 * Instead of one child per job, a single child is run for a batch of
+	 * consecutive jobs. Its arguments are the first fixed_args arguments of
+	 * the first job of the batch, followed by the remaining arguments of
+	 * every job in the batch. The output of the child is split back into
+	 * per-job outputs by the splitter and each part gets its own doFull()
+	 * call with the job's ID.
+	 *
+	 * Batches are large at the start of a run, to pay the process startup
+	 * cost rarely, and shrink towards the end so that all threads finish at
+	 * about the same time. They never exceed the system's ARG_MAX, and
+	 * batches sent to a daemon (see addRemoteNode()) also stay within the
+	 * arguments and bytes a spawn request may carry.
+	 *
+	 * \param fixed_args the number of leading arguments (including the
+	 * executable name) which are the same for all jobs. Must be at least 1.
+	 * \param splitter splits the output of a batch into per-job outputs.
+	 * \param max_batch the maximum number of jobs per batch. If 0 (default),
+	 * batches are only limited by ARG_MAX.
+	 */
+	void setBatching(unsigned int fixed_args, OutputSplitter *splitter,
+			unsigned int max_batch = 0U) {
+		if (fixed_args == 0) {
+			throw "ThreadPool: The executable name cannot be batched.";
+		}
+		if (!pipelines.empty()) {
+			throw "ThreadPool: Pipelines cannot be batched.";
+		}
+		if (graph && graph->hasDependencies()) {
+			throw "ThreadPool: Jobs with dependencies cannot be batched.";
+		}
+		if (splitter == 0) {
+			throw "ThreadPool: Batching requires an output splitter.";
+		}
+		if (speculation_factor > 0) {
+			throw "ThreadPool: Batches cannot be re-executed speculatively.";
+		}
+		this->batch_fixed_args = fixed_args;
+		this->splitter = splitter;
+		this->batch_max = max_batch;
+	}
+	/*!
+	 * \brief Makes a job wait for another job.
+	 *
+	 * The job is started only after the prerequisite has finished
+	 * successfully, i.e., its child exited normally and its data action has
+	 * run (or has been queued, see setConsumers()). If the prerequisite
+	 * fails, the job and everything depending on it are skipped. Among the
+	 * jobs which are ready to run, the one heading the most expensive chain of
+	 * dependent jobs is started first (see setJobCost()). run() fails if the
+	 * dependencies contain a cycle.
+	 *
+	 * \param job the ID (index) of the dependent job.
+	 * \param prerequisite the ID of the job it depends on.
+	 */
+	void addDependency(unsigned int job, unsigned int prerequisite) {
+		if (job >= jobCount() || prerequisite >= jobCount()) {
+			throw "ThreadPool: Job ID out of range.";
+		}
+		if (job == prerequisite) {
+			throw "ThreadPool: A job cannot depend on itself.";
+		}
+		if (batch_fixed_args != 0) {
+			throw "ThreadPool: Jobs with dependencies cannot be batched.";
+		}
+		if (ordered) {
+			throw "ThreadPool: Jobs with dependencies cannot be delivered in order.";
+		}
+		if (!graph) {
+			graph.reset(new JobGraph(jobCount()));
+		}
+		graph->addDependency(job, prerequisite);
+	}
+	/*!
+	 * \brief Sets the estimated cost (e.g., the expected run time) of a job,
+	 * which is used to find the critical path of the dependency graph. All
+	 * jobs cost 1 by default. Without dependencies, the most expensive jobs
+	 * are started first, unless the jobs are batched or delivered in order,
+	 * in which case the costs are ignored.
+	 */
+	void setJobCost(unsigned int job, double cost) {
+		if (job >= jobCount()) {
+			throw "ThreadPool: Job ID out of range.";
+		}
+		if (!graph) {
+			graph.reset(new JobGraph(jobCount()));
+		}
+		graph->setCost(job, cost);
+	}
+	/*!
+	 * \brief Runs the data actions on a separate set of consumer threads.
+	 *
+	 * By default, doFull() runs in the worker thread which ran the child, and
+	 * no new child is started in its place until doFull() returns. With
+	 * consumer threads, a worker thread queues the output and finishes as
+	 * soon as the child exits, so parsing and child execution overlap. If
+	 * the queue is full, worker threads wait for the consumers to catch up.
+	 *
+	 * \param consumer_count the number of consumer threads. If 0, the data
+	 * actions run in the worker threads.
+	 * \param queue_capacity the maximum number of outputs waiting for a
+	 * consumer thread. If 0 (default), it is twice the number of consumers.
+	 */
+	void setConsumers(unsigned int consumer_count,
+			unsigned int queue_capacity = 0U) {
+		this->consumer_count = consumer_count;
+		this->queue_capacity = queue_capacity != 0 ? queue_capacity
+				: 2 * consumer_count;
+	}
+	/*!
+	 * \brief Delivers the outputs to the data actions in job ID order.
+	 *
+	 * Outputs of jobs which finish early are held back until all jobs before
+	 * them have been delivered. To bound the memory this takes, no new job is
+	 * started while the window is full; the running jobs continue. Jobs whose
+	 * child fails are skipped. With more than one consumer thread (see
+	 * setConsumers()), outputs are queued in order but may be processed
+	 * concurrently.
+	 *
+	 * \param max_entries the maximum number of job IDs from the oldest
+	 * undelivered job to the newest started job. If 0, not limited.
+	 * \param max_bytes the maximum number of bytes of output held back. If 0
+	 * (default), not limited.
+	 */
+	void setOrdered(unsigned int max_entries, size_t max_bytes = 0) {
+		if (graph && graph->hasDependencies()) {
+			throw "ThreadPool: Jobs with dependencies cannot be delivered in order.";
+		}
+		this->ordered = true;
+		this->reorder_entries = max_entries;
+		this->reorder_bytes = max_bytes;
+	}
+	/*!
+	 * \brief Limits the memory used by the buffered output of all children.
+	 *
+	 * Output counts against the budget from the moment it is read until its
+	 * buffer is freed after doFull(). While the budget is exhausted, worker
+	 * threads stop reading from their pipes, which makes the children block
+	 * on write instead of being killed, and no new jobs are started. The
+	 * oldest running job may exceed the budget, by up to its own output plus
+	 * one read, so that a run can always make progress.
+	 *
+	 * \param bytes the maximum number of bytes of buffered output.
+	 */
+	void setMemoryBudget(size_t bytes) {
+		budget.reset(new MemoryBudget(bytes));
+	}
+	/*!
+	 * \brief Records a timeline of every run and writes it to a file in the
+	 * Chrome trace event format, for chrome://tracing or Perfetto.
+	 *
+	 * Every thread slot gets its own track showing the phases of its jobs:
+	 * spawning (pipe and fork), the child running while its output is read,
+	 * waitpid and doFull. The scheduler and the consumer threads get tracks
+	 * of their own. Events are kept in a ring buffer per track, so the
+	 * oldest events are lost if a track records more than events_per_track.
+	 *
+	 * \param path the file to write, or NULL to disable tracing.
+	 * \param events_per_track the number of events kept per track.
+	 */
+	void setTrace(const char *path, size_t events_per_track = 65536) {
+		trace_path = path;
+		trace_capacity = events_per_track;
+	}
+	/*!
+	 * \brief Writes the metrics in the Prometheus text format to a file
+	 * during every run, e.g. for the node exporter's textfile collector.
+	 *
+	 * The file is written every interval_ms milliseconds and once more at
+	 * the end of a run, and replaced atomically every time.
+	 *
+	 * \param path the file to write, or NULL to disable writing.
+	 * \param interval_ms the time between two writes, in milliseconds.
+	 */
+	void setMetricsFile(const char *path, unsigned int interval_ms = 1000U) {
+		metrics_path = path;
+		metrics_interval = interval_ms > 0 ? interval_ms : 1U;
+	}
+	/*!
+	 * \brief Returns the live metrics of the pool. They may be read from any
+	 * thread while run() is running.
+	 */
+	const Metrics &getMetrics() const {
+		return *metrics;
+	}
+	/*!
+	 * \brief Returns the number of bytes of buffered output currently held,
+	 * or 0 without a memory budget. May be called while run() is running.
+	 */
+	size_t getMemoryUsage() const {
+		return budget ? budget->getUsage() : 0;
+	}
+	/*!
+	 * \brief Returns the peak number of bytes of buffered output held, or 0
+	 * without a memory budget.
+	 */
+	size_t getMemoryPeak() const {
+		return budget ? budget->getPeak() : 0;
+	}
+	/*!
+	 * \brief Returns the statistics of the consumer queue, i.e., its peak
+	 * depth and how long worker and consumer threads waited on it during
+	 * the last run.
+	 */
+	const QueueStats &getConsumerStats() const {
+		return consumer_stats;
+	}
 };
 
 }
@@ -0,0 +1,151 @@
+/*
+ * Copyright 2014 Nedim Srndic, University of Tuebingen
+ *
+ * This file is part of libquickly.
+
+ * libquickly is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libquickly is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libquickly.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Tracer.cpp
+ *  Created on: Oct 19, 2026
+ */
+
+#include <cstdio>	// snprintf()
+#include <fstream>
+
+#include <time.h>	// clock_gettime()
+#include <unistd.h>	// getpid()
+#include "Tracer.h"
+
+namespace quickly {
+
+// The track bound to the calling thread. Tracks are owned by their Tracer,
+// so the cleanup function does nothing.
+static void noCleanup(TraceBuffer *) {
+}
+static boost::thread_specific_ptr<TraceBuffer> current_track(noCleanup);
+
+// Returns the current time in microseconds
+static unsigned long long now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+// Writes text as a quoted JSON string. Track names may contain remote
+// addresses, which may contain anything a path can.
+static void writeString(std::ostream &out, const char *text) {
+	out << '"';
+	for (const char *c = text; *c != '\0'; c++) {
+		switch (*c) {
+		case '"':
+			out << "\\\"";
+			break;
+		case '\\':
+			out << "\\\\";
+			break;
+		case '\n':
+			out << "\\n";
+			break;
+		case '\t':
+			out << "\\t";
+			break;
+		default:
+			if ((unsigned char) *c < 0x20) {
+				char escape[8];
+				snprintf(escape, sizeof(escape), "\\u%04x", (unsigned char) *c);
+				out << escape;
+			} else {
+				out << *c;
+			}
+		}
+	}
+	out << '"';
+}
+
+Tracer::Tracer(size_t capacity) :
+		capacity(capacity), tracks(), mutex() {
+}
+
+Tracer::~Tracer() {
+	for (size_t i = 0; i < tracks.size(); i++) {
+		delete tracks[i];
+	}
+}
+
+TraceBuffer *Tracer::track(const std::string &name) {
+	TraceBuffer *buffer = new TraceBuffer(name, capacity);
+	boost::mutex::scoped_lock lock(mutex);
+	tracks.push_back(buffer);
+	return buffer;
+}
+
+void Tracer::bind(TraceBuffer *buffer) {
+	current_track.reset(buffer);
+}
+
+void Tracer::record(const char *name, char phase, unsigned int job) {
+	TraceBuffer *buffer = current_track.get();
+	if (buffer == (TraceBuffer *) NULL) {
+		return;
+	}
+	TraceEvent event;
+	event.name = name;
+	event.phase = phase;
+	event.ts = now();
+	event.job = job;
+	buffer->record(event);
+}
+
+bool Tracer::write(const char *path) const {
+	std::ofstream out(path);
+	if (!out) {
+		return false;
+	}
+	const pid_t pid = getpid();
+	boost::mutex::scoped_lock lock(mutex);
+	out << "{\"traceEvents\":[\n";
+	bool first = true;
+	for (size_t tid = 0; tid < tracks.size(); tid++) {
+		const TraceBuffer *buffer = tracks[tid];
+		// Name the track
+		out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":"
+				<< pid << ",\"tid\":" << tid << ",\"args\":{\"name\":";
+		writeString(out, buffer->name.c_str());
+		out << "}}";
+		first = false;
+
+		// Dump the events still in the ring, oldest first
+		const unsigned long head = buffer->head.load(boost::memory_order_acquire);
+		const unsigned long size = buffer->events.size();
+		for (unsigned long i = head > size ? head - size : 0; i < head; i++) {
+			const TraceEvent &event = buffer->events[i % size];
+			out << ",\n{\"name\":";
+			writeString(out, event.name);
+			out << ",\"ph\":\"" << event.phase
+					<< "\",\"ts\":" << event.ts << ",\"pid\":" << pid << ",\"tid\":"
+					<< tid;
+			if (event.phase == 'i') {
+				out << ",\"s\":\"t\"";
+			}
+			if (event.job != NO_JOB) {
+				out << ",\"args\":{\"job\":" << event.job << "}";
+			}
+			out << "}";
+		}
+	}
+	out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+	return out.good();
+}
+
+} /* namespace quickly */
@@ -0,0 +1,150 @@
+/*
+ * Copyright 2014 Nedim Srndic, University of Tuebingen
+ *
+ * This file is part of libquickly.
+
+ * libquickly is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libquickly is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libquickly.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Tracer.h
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef QUICKLY_TRACER_H_
+#define QUICKLY_TRACER_H_
+
+#include <cstddef>	// size_t
+#include <string>
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
+
+namespace quickly {
+
+/*
+ * A single trace point.
+ */
+struct TraceEvent {
+	// The name of the phase, must be a string literal
+	const char *name;
+	// 'B' for the begin of a phase, 'E' for its end, 'i' for an instant
+	char phase;
+	// Microseconds on the monotonic clock
+	unsigned long long ts;
+	// The job the event belongs to, Tracer::NO_JOB if none
+	unsigned int job;
+};
+
+/*
+ * A ring buffer of trace events written by a single thread at a time. Once
+ * full, the oldest events are overwritten.
+ */
+class TraceBuffer {
+private:
+	// The name of the track in the trace viewer
+	std::string name;
+	// The events
+	std::vector<TraceEvent> events;
+	// The number of events ever recorded
+	boost::atomic<unsigned long> head;
+public:
+	TraceBuffer(const std::string &name, size_t capacity) :
+			name(name), events(capacity > 0 ? capacity : 1), head(0UL) {
+	}
+	// Records an event. Must only be called by the thread bound to the
+	// buffer.
+	void record(const TraceEvent &event) {
+		const unsigned long i = head.load(boost::memory_order_relaxed);
+		events[i % events.size()] = event;
+		head.store(i + 1, boost::memory_order_release);
+	}
+	friend class Tracer;
+};
+
+/*
+ * Collects a timeline of a run and writes it in the Chrome trace event
+ * format, which can be loaded into chrome://tracing or Perfetto.
+ *
+ * Every thread which records events is bound to its own TraceBuffer (a
+ * "track"), so recording takes no locks. Worker threads bind to the track of
+ * their slot in the thread pool, which shows slot usage and idle gaps
+ * directly. Threads which are not bound record nothing, and the static
+ * recording functions cost only a thread-local lookup in that case.
+ */
+class Tracer {
+private:
+	// The number of events kept per track
+	size_t capacity;
+	// All tracks, in order of creation
+	std::vector<TraceBuffer *> tracks;
+	// Protects tracks
+	mutable boost::mutex mutex;
+
+	// Records an event on the track bound to the calling thread
+	static void record(const char *name, char phase, unsigned int job);
+
+	// Noncopyable
+	Tracer(const Tracer &);
+	Tracer &operator =(const Tracer &);
+public:
+	// The job of an event which belongs to no job
+	static const unsigned int NO_JOB = (unsigned int) -1;
+
+	// Constructor
+	explicit Tracer(size_t capacity);
+	// Destructor, frees all tracks
+	~Tracer();
+
+	// Creates a new track with the given name
+	TraceBuffer *track(const std::string &name);
+	// Binds the calling thread to a track, or unbinds it if NULL
+	static void bind(TraceBuffer *buffer);
+
+	// Records the begin of a phase
+	static void begin(const char *name, unsigned int job = NO_JOB) {
+		record(name, 'B', job);
+	}
+	// Records the end of a phase
+	static void end(const char *name, unsigned int job = NO_JOB) {
+		record(name, 'E', job);
+	}
+	// Records an instant event
+	static void instant(const char *name, unsigned int job = NO_JOB) {
+		record(name, 'i', job);
+	}
+
+	// Writes all recorded events as Chrome trace JSON. Returns false if the
+	// file cannot be written. Must not be called while events are recorded.
+	bool write(const char *path) const;
+};
+
+/*
+ * Records a phase spanning the lifetime of the object.
+ */
+class TraceSpan {
+private:
+	const char *name;
+	unsigned int job;
+public:
+	explicit TraceSpan(const char *name, unsigned int job = Tracer::NO_JOB) :
+			name(name), job(job) {
+		Tracer::begin(name, job);
+	}
+	~TraceSpan() {
+		Tracer::end(name, job);
+	}
+};
+
+} /* namespace quickly */
+#endif /* QUICKLY_TRACER_H_ */
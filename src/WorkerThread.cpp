@@ -20,200 +20,352 @@
  *  Created on: Apr 28, 2011
  */
 
-#include <cstdio>	// perror()
-#include <cstdlib>	// EXIT_FAILURE
 #include <climits>	// PIPE_BUF
 #include <fstream>
 #include <iostream>
 #include <sstream>
 
 #include <errno.h>	// errno
-#include <fcntl.h>	// open(), fcntl()
+#include <poll.h>	// poll()
 #include <signal.h> // kill()
-#include <sys/resource.h> // setrlimit()
-#include <sys/types.h>	// fork(), open()
+#include <sys/types.h>	// pid_t
 #include <sys/wait.h> // waitpid()
-#include <unistd.h>	// pipe(), close(), fork(), dup2(), execv(), fcntl()
+#include <unistd.h>	// read(), close()
+#include <boost/bind/bind.hpp>
+#include "ChildProcess.h"
+#include "RemoteProtocol.h"
 #include "WorkerThread.h"
 
 namespace quickly {
 
-const char * POPEN2_MSGS[] = {"", // 0
-								"Call to pipe() failed.", // -1
-								"Call to fork() failed.", // -2
-								"Call to fcntl() using F_GETFL failed.", // -3
-								"Attempt to use non-blocking reads failed.", // -4
-								};
+void WorkerThread::message(const char *message) {
+	boost::mutex::scoped_lock lock(print_mutex);
+	std::cerr << "Thread " << boost::this_thread::get_id() << ": " << message
+			<< std::endl;
+}
 
-/*
- * Forks a new process and connects its standard output to the parent's
- * standard input, then runs execv() to run the child. 
- *
- * Returns the child's
- * PID when OK or a negative number if an error is encountered.
- * Inspired by http://snippets.dzone.com/posts/show/1134
- */
-pid_t popen2(const char *proc, const char * const *argv, int *outfp, unsigned int vm_lim = 0U, unsigned int CPU_lim = 0U) {
-	const int READ = STDIN_FILENO;
-	const int WRITE = STDOUT_FILENO;
-	const int ERR = STDERR_FILENO;
-	int p_stdout[2];
-	pid_t pid;
+bool WorkerThread::deliver(const boost::shared_ptr<std::stringstream> &buffer,
+		size_t bytes) {
+	JobOutput output;
+	output.id = id;
+	output.count = count;
+	output.buffer = buffer;
+	output.bytes = bytes;
+	if (reorder != (ReorderBuffer *) NULL) {
+		reorder->add(output);
+	} else if (consumers != (ConsumerStage *) NULL) {
+		// Free this thread's slot as soon as possible
+		consumers->push(output);
+	} else if (!runDataActions(data_action, splitter, id, count, *buffer,
+			cancellation, metrics)) {
+		message("could not split the output of a batch");
+		return false;
+	}
+	return true;
+}
 
-	// Create a pipe
-	if (pipe(p_stdout) == -1)
-		return -1;
+bool WorkerThread::abandoned() {
+	return (cancellation != (Cancellation *) NULL && cancellation->isCancelled())
+			|| (claims != (JobClaims *) NULL && claims->isResolved(id));
+}
 
-	pid = fork();
+bool WorkerThread::childFailed(const ChildParams &params) {
+	if (abandoned()) {
+		// Killed on purpose
+		return false;
+	}
+	std::string errmsg("child process killed: ");
+	for (int ei = 0; params.getArgv()[ei] != NULL; ei++) {
+		errmsg += params.getArgv()[ei];
+		errmsg += " ";
+	}
+	message(errmsg.c_str());
+	return false;
+}
 
-	if (pid == -1) {
-		// Fork failed
-		close(p_stdout[READ]);
-		close(p_stdout[WRITE]);
-		return -2;
-	} else if (pid == 0) {
-		// Child process
-		// Don't read from stdout
-		close(p_stdout[READ]);
-		// Pipe child's stdout to parent's stdin
-		if (dup2(p_stdout[WRITE], WRITE) == -1) {
-			std::exit(EXIT_FAILURE);
-		}
+boost::shared_ptr<std::stringstream> WorkerThread::newBuffer(
+		BudgetedBuffer *&budgeted) {
+	budgeted = (BudgetedBuffer *) NULL;
+	if (budget != (MemoryBudget *) NULL) {
+		budgeted = new BudgetedBuffer(budget);
+		return boost::shared_ptr<std::stringstream>(budgeted);
+	}
+	return boost::shared_ptr<std::stringstream>(new std::stringstream);
+}
 
-		// Pipe stderr to /dev/null
-		int std_err = open("/dev/null", O_WRONLY);
-		if (std_err == -1) {
-			std::exit(EXIT_FAILURE);
+bool WorkerThread::succeed(const boost::shared_ptr<std::stringstream> &buffer,
+		size_t bytes, unsigned long long start_us) {
+	if (claims != (JobClaims *) NULL) {
+		// Only the first attempt to succeed delivers its output
+		if (!claims->claim(id)) {
+			return false;
 		}
-		if (dup2(std_err, ERR) == -1) {
-			std::exit(EXIT_FAILURE);
+		cancellation->killJob(id);
+	}
+	{
+		TraceSpan span("deliver", id);
+		if (!deliver(buffer, bytes)) {
+			return false;
 		}
+	}
+	if (metrics != (Metrics *) NULL) {
+		metrics->job_duration.observe(Metrics::now() - start_us);
+	}
+	return true;
+}
 
-		/* In order to use the argv parameter, which is of type
-		 * "const char * const *" with execv, which accepts a "char * const *",
-		 * we must use a const_cast. It is safe to use it here, as is discussed
-		 * in http://stackoverflow.com/questions/190184/execv-and-const-ness */
-		char * const *argv_nonconst = const_cast<char * const *>(argv);
+bool WorkerThread::runRemote(const std::vector<ChildParams> &procs) {
+	// Hand the job over to the daemon
+	const unsigned long long start_us =
+			metrics != (Metrics *) NULL ? Metrics::now() : 0ULL;
+	Tracer::begin("spawn", id);
+	const int sock = connectRemote(remote,
+			boost::bind(&WorkerThread::abandoned, this));
+	const bool sent = sock != -1 && writeSpawnRequest(sock, procs, remote_secret);
+	Tracer::end("spawn", id);
+	if (metrics != (Metrics *) NULL) {
+		metrics->spawn_latency.observe(Metrics::now() - start_us);
+	}
+	if (!sent) {
+		if (sock != -1) {
+			close(sock);
+		}
+		std::string errmsg("could not send the job to ");
+		errmsg += remote;
+		message(errmsg.c_str());
+		return false;
+	}
 
-		if (vm_lim != 0U) {
-			// Limit virtual memory size
-			struct rlimit rl;
-			rl.rlim_cur = vm_lim;
-			rl.rlim_max = vm_lim;
-			if (setrlimit(RLIMIT_AS, &rl) == -1) {
-				std::exit(EXIT_FAILURE);
-			}
+	// Fill a buffer with the output streamed back by the daemon
+	BudgetedBuffer *budgeted;
+	boost::shared_ptr<std::stringstream> buffer = newBuffer(budgeted);
+	size_t total_bytes = 0;
+	struct pollfd pfd;
+	pfd.fd = sock;
+	pfd.events = POLLIN;
+	Tracer::begin("child", id);
+	while (true) {
+		// Closing the connection kills the job, so check before every frame,
+		// and every 10 ms while none arrives, whether it is still needed
+		if (abandoned()) {
+			Tracer::end("child", id);
+			close(sock);
+			return false;
 		}
-		if (CPU_lim != 0) {
-			// Limit CPU time
-			struct rlimit rl;
-			rl.rlim_cur = CPU_lim;
-			rl.rlim_max = CPU_lim;
-			if (setrlimit(RLIMIT_CPU, &rl) == -1) {
-				std::exit(EXIT_FAILURE);
-			}
+		const int r = poll(&pfd, 1, 10);
+		if (r == 0 || (r == -1 && errno == EINTR)) {
+			continue;
 		}
-
-		// Replace process image
-		execv(proc, argv_nonconst);
-		// Replace failed, show error and exit
-		std::perror("execv");
-		std::exit(EXIT_FAILURE);
-	} else {
-		// Parent process
-		// Return a handle to the newly created pipe
-		*outfp = p_stdout[READ];
-		// Don't write to the new pipe
-		close(p_stdout[WRITE]);
-		// Use non-blocking reads
-		int flags = fcntl(p_stdout[READ], F_GETFL, 0);
-		if (flags == -1) {
-			close(p_stdout[READ]);
-			perror("fcntl F_GETFL");
-			return -3;
+		char type;
+		std::string payload;
+		if (r == -1 || !readFrame(sock, type, payload)) {
+			Tracer::end("child", id);
+			close(sock);
+			std::string errmsg("lost the connection to ");
+			errmsg += remote;
+			message(errmsg.c_str());
+			return false;
 		}
-
-		if (fcntl(p_stdout[READ], F_SETFL, flags | O_NONBLOCK) == -1) {
-			close(p_stdout[READ]);
-			perror("fcntl F_SETFL");
-			return -4;
+		if (type == REMOTE_OUTPUT) {
+			if (budgeted != (BudgetedBuffer *) NULL) {
+				// The daemon blocks on write while this thread waits
+				budget->acquire(id, payload.size());
+				budgeted->charge(payload.size());
+			}
+			if (total_bytes == 0) {
+				Tracer::instant("first output", id);
+			}
+			buffer->write(payload.data(), payload.size());
+			total_bytes += payload.size();
+			if (metrics != (Metrics *) NULL) {
+				metrics->bytes_read.add(payload.size());
+			}
+		} else if (type == REMOTE_EXIT) {
+			Tracer::end("child", id);
+			close(sock);
+			std::vector<RemoteStatus> statuses;
+			if (!decodeExit(payload, statuses)
+					|| statuses.size() != procs.size()) {
+				message("malformed exit status from the daemon");
+				return false;
+			}
+			// The same rules as for local children apply
+			for (size_t i = 0; i < statuses.size(); i++) {
+				const bool broken_pipe = i + 1 < statuses.size()
+						&& statuses[i].kind == REMOTE_SIGNALED
+						&& statuses[i].value == SIGPIPE;
+				if (statuses[i].kind != REMOTE_EXITED && !broken_pipe) {
+					return childFailed(procs[i]);
+				}
+			}
+			return succeed(buffer, total_bytes, start_us);
+		} else { // Error
+			Tracer::end("child", id);
+			close(sock);
+			std::string errmsg(remote);
+			errmsg += ": ";
+			errmsg += payload;
+			message(errmsg.c_str());
+			return false;
 		}
-		return pid;
 	}
 }
 
-void WorkerThread::message(const char *message) {
-	boost::mutex::scoped_lock lock(print_mutex);
-	std::cerr << "Thread " << boost::this_thread::get_id() << ": " << message
-			<< std::endl;
-}
-
-void WorkerThread::operator ()(void) {
-	if (child_params.getChildProc() == 0) {
-		message("Child process name not set.");
+bool WorkerThread::runChild() {
+	// A single child is a pipeline of one stage
+	std::vector<ChildParams> procs(stages);
+	if (procs.empty()) {
+		procs.push_back(child_params);
 	}
-	if (child_params.getArgv() == 0) {
-		message("Child process arguments not set.");
-		return;
+	for (size_t i = 0; i < procs.size(); i++) {
+		if (procs[i].getChildProc() == 0) {
+			message("Child process name not set.");
+			return false;
+		}
+		if (procs[i].getArgv() == 0) {
+			message("Child process arguments not set.");
+			return false;
+		}
 	}
 	if (id == (unsigned int) -1) {
 		message("Result id not set.");
-		return;
+		return false;
+	}
+	if (remote != (const char *) NULL) {
+		return runRemote(procs);
 	}
 
-	// Initialize a new data action
-	DataActionBase *action = data_action->create(id);
-
-	// Runs a new instance of the child process
+	// Runs a new instance of the child process(es)
 	int fd;
-	const pid_t PID = popen2(child_params.getChildProc(), child_params.getArgv(),
-			&fd, child_params.getVmLimit(), child_params.getCpuLimit());
+	std::vector<pid_t> pids;
+	const unsigned long long start_us =
+			metrics != (Metrics *) NULL ? Metrics::now() : 0ULL;
+	Tracer::begin("spawn", id);
+	// The children run in a process group of their own, so that a
+	// cancellation also kills the processes they fork
+	const pid_t PID = popenPipeline(procs, &fd, pids, true);
+	Tracer::end("spawn", id);
+	if (metrics != (Metrics *) NULL) {
+		metrics->spawn_latency.observe(Metrics::now() - start_us);
+	}
 	if (PID < 0) {
 		message(POPEN2_MSGS[-PID]);
-		delete action;
-		return;
+		return false;
+	}
+	// If the run is cancelled already, the stages get killed right away and
+	// the job fails once its output is drained.
+	const pid_t leader = pids.front();
+	if (cancellation != (Cancellation *) NULL) {
+		cancellation->enter(id, pids, true);
 	}
 	
 	// Fill a buffer with the data output from the child process.
-	std::stringstream buffer;
+	BudgetedBuffer *budgeted;
+	boost::shared_ptr<std::stringstream> buffer = newBuffer(budgeted);
 	char read_buf[PIPE_BUF];
 	size_t nbytes = sizeof(read_buf);
 	ssize_t bytes_read;
+	size_t total_bytes = 0;
+	// Covers the run time of the child and the draining of its output
+	Tracer::begin("child", id);
 	while (true) {
-		bytes_read = read(fd, read_buf, nbytes);
+		if (budgeted != (BudgetedBuffer *) NULL) {
+			// Reserve room for a full read, leaving the data in the pipe
+			// while the budget is exhausted
+			budget->acquire(id, nbytes);
+			bytes_read = read(fd, read_buf, nbytes);
+			const size_t kept = bytes_read > 0 ? bytes_read : 0;
+			budget->release(nbytes - kept);
+			budgeted->charge(kept);
+		} else {
+			bytes_read = read(fd, read_buf, nbytes);
+		}
 		if (bytes_read > 0) { // Success
-			buffer.write(read_buf, bytes_read);
+			if (total_bytes == 0) {
+				Tracer::instant("first output", id);
+			}
+			buffer->write(read_buf, bytes_read);
+			total_bytes += bytes_read;
+			if (metrics != (Metrics *) NULL) {
+				metrics->bytes_read.add(bytes_read);
+			}
 		} else if (bytes_read == 0) { // EOF
+			Tracer::end("child", id);
 			close(fd);
-			int status = 0;
-			int r = waitpid(PID, &status, 0);
-			if (r != PID or not WIFEXITED(status)) { // Problematic child
-				std::string errmsg("child process killed: ");
-				for (int ei = 0; child_params.getArgv()[ei] != NULL; ei++) {
-					errmsg += child_params.getArgv()[ei];
-					errmsg += " ";
+			if (cancellation != (Cancellation *) NULL) {
+				cancellation->leave(id, leader);
+			}
+			// Reap all stages. Earlier stages may be killed by SIGPIPE when a
+			// later one exits without reading all of its input, like in a
+			// shell pipeline; that is not a failure.
+			size_t failed = pids.size();
+			Tracer::begin("waitpid", id);
+			for (size_t i = 0; i < pids.size(); i++) {
+				int status = 0;
+				int r = waitpid(pids[i], &status, 0);
+				const bool broken_pipe = i + 1 < pids.size()
+						&& WIFSIGNALED(status) && WTERMSIG(status) == SIGPIPE;
+				if ((r != pids[i] or not WIFEXITED(status)) && !broken_pipe
+						&& failed == pids.size()) {
+					failed = i;
+				}
+				if (r != pids[i]) {
+					kill(pids[i], SIGKILL);
 				}
-				message(errmsg.c_str());
-				kill(PID, SIGKILL);
-				delete action;
-				return;
+			}
+			Tracer::end("waitpid", id);
+			if (failed != pids.size()) { // Problematic child
+				return childFailed(procs[failed]);
 			} else { // Done reading
-				// Run the doFull action with the buffered data
-				action->doFull(buffer);
-				delete action;
-				break;
+				return succeed(buffer, total_bytes, start_us);
 			}
 		} else if (bytes_read == -1 && errno == EAGAIN) { // Empty pipe
 			static const boost::posix_time::time_duration timeout =
 					boost::posix_time::milliseconds(10);
 			boost::this_thread::sleep(timeout);
 		} else { // Error
+			Tracer::end("child", id);
 			message("read() error");
 			close(fd);
-			waitpid(PID, NULL, 0);
-			delete action;
-			return;
+			if (cancellation != (Cancellation *) NULL) {
+				cancellation->leave(id, leader);
+			}
+			for (size_t i = 0; i < pids.size(); i++) {
+				waitpid(pids[i], NULL, 0);
+			}
+			return false;
 		}
 	}
 }
+
+void WorkerThread::operator ()(void) {
+	Tracer::bind(trace);
+	Tracer::begin("job", id);
+	if (budget != (MemoryBudget *) NULL) {
+		budget->enter(id);
+	}
+	const bool succeeded = runChild();
+	// Of several attempts of a job, only the one which resolves it reports
+	// the outcome
+	const bool reports = succeeded || claims == (JobClaims *) NULL
+			|| claims->fail(id);
+	if (budget != (MemoryBudget *) NULL) {
+		budget->leave(id);
+	}
+	// Successful jobs are counted once their data actions have run, failed
+	// ones by the pool, which knows whether they were killed on purpose
+	if (success != (bool *) NULL) {
+		*success = succeeded;
+	}
+	if (!succeeded && reports && reorder != (ReorderBuffer *) NULL) {
+		// Let the jobs after this one through
+		JobOutput failed;
+		failed.id = id;
+		failed.count = count;
+		failed.bytes = 0;
+		reorder->add(failed);
+	}
+	Tracer::end("job", id);
+	Tracer::bind((TraceBuffer *) NULL);
+}
 }
@@ -23,10 +23,21 @@
 #ifndef QUICKLY_WORKERTHREAD_H_
 #define QUICKLY_WORKERTHREAD_H_
 
+#include <sstream>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
 #include <boost/thread.hpp>
 
+#include "Cancellation.h"
 #include "ChildParams.h"
+#include "ConsumerStage.h"
 #include "DataAction.h"
+#include "JobClaims.h"
+#include "MemoryBudget.h"
+#include "Metrics.h"
+#include "ReorderBuffer.h"
+#include "Tracer.h"
 
 namespace quickly {
 /*
@@ -39,21 +50,83 @@ namespace quickly {
 class WorkerThread {
 	// Parameters for the child process
 	ChildParams child_params;
+	// Parameters for the stages of a pipeline, empty to run child_params
+	std::vector<ChildParams> stages;
 	// The ID of the result that this thread produces
 	unsigned int id;
+	// The number of jobs in the batch handled by this thread, with
+	// consecutive IDs starting at id
+	unsigned int count;
 	// An action to perform on the results obtained from the child processes
 	DataActionBase *data_action;
+	// Splits the output of a batch into per-job outputs, NULL if not batching
+	OutputSplitter *splitter;
+	// Owns the argument array of a batch, which ThreadPool builds on the fly
+	boost::shared_ptr<std::vector<const char *> > argv_storage;
+	// Runs the data actions on other threads, NULL to run them in this one
+	ConsumerStage *consumers;
+	// Delivers the outputs in job ID order, NULL to deliver them right away
+	ReorderBuffer *reorder;
+	// Limits the memory used by buffered output, may be NULL
+	MemoryBudget *budget;
+	// The trace track of this thread's slot, NULL if not tracing
+	TraceBuffer *trace;
+	// Live metrics of the pool, may be NULL
+	Metrics *metrics;
+	// Cancels the run, may be NULL
+	Cancellation *cancellation;
+	// Picks the attempt which reports the job if it may run more than once,
+	// NULL otherwise
+	JobClaims *claims;
+	// The address of the quickly-worker daemon which runs the child, NULL
+	// to run it locally
+	const char *remote;
+	// The secret shared with that daemon, may be NULL
+	const char *remote_secret;
+	// Where to store whether the job succeeded, may be NULL
+	bool *success;
 	// A mutex for thread-safe message printing
 	mutable boost::mutex print_mutex;
 
 	// Prints a formatted message to stdout using locks to ensure correct
 	// printing
 	void message(const char *message);
+	// Runs or queues the data action(s) on the output of a successful child.
+	// Returns false if the output of a batch could not be split, which is
+	// only known here if the actions run in this thread.
+	bool deliver(const boost::shared_ptr<std::stringstream> &buffer,
+			size_t bytes);
+	// Returns true if the job is no longer needed, because the run was
+	// cancelled or another attempt of the job succeeded
+	bool abandoned();
+	// Reports that a child was killed, unless on purpose. Returns false.
+	bool childFailed(const ChildParams &params);
+	// Creates the buffer for the output of the child, charged to the memory
+	// budget if there is one
+	boost::shared_ptr<std::stringstream> newBuffer(BudgetedBuffer *&budgeted);
+	// Delivers the output of a successful child, unless another attempt of
+	// the job was first. Returns true if the output was delivered (or
+	// queued).
+	bool succeed(const boost::shared_ptr<std::stringstream> &buffer,
+			size_t bytes, unsigned long long start_us);
+	// Runs the child(ren) on a quickly-worker daemon and delivers the output
+	bool runRemote(const std::vector<ChildParams> &procs);
+	// Runs the child and delivers its output. Returns false if the child
+	// could not be run or failed.
+	bool runChild();
 public:
 	// Constructor (must have an empty constructor for Boost.Threading)
 	WorkerThread() :
-			child_params(), id((unsigned int) -1), data_action(
-					(DataActionBase *) NULL) {
+			child_params(), stages(), id((unsigned int) -1), count(1U), data_action(
+					(DataActionBase *) NULL), splitter((OutputSplitter *) NULL),
+					argv_storage(), consumers((ConsumerStage *) NULL),
+					reorder((ReorderBuffer *) NULL),
+					budget((MemoryBudget *) NULL), trace((TraceBuffer *) NULL),
+					metrics((Metrics *) NULL),
+					cancellation((Cancellation *) NULL),
+					claims((JobClaims *) NULL), remote((const char *) NULL),
+					remote_secret((const char *) NULL),
+					success((bool *) NULL) {
 	}
 
 	/*
@@ -63,7 +136,13 @@ public:
 	 * More info: http://boost.cppll.jp/BDTJ_1_29/libs/thread/doc/faq.html#question5
 	 */
 	WorkerThread(const WorkerThread &other) : child_params(other.child_params),
-			id(other.id), data_action(other.data_action) {
+			stages(other.stages), id(other.id), count(other.count), data_action(other.data_action),
+			splitter(other.splitter), argv_storage(other.argv_storage),
+			consumers(other.consumers), reorder(other.reorder),
+			budget(other.budget), trace(other.trace), metrics(other.metrics),
+			cancellation(other.cancellation), claims(other.claims),
+			remote(other.remote), remote_secret(other.remote_secret),
+			success(other.success) {
 	}
 	// Assignment operator automatic
 	// Destructor
@@ -82,6 +161,112 @@ public:
 		return true;
 	}
 
+	/*
+	 * Initializes the thread to run a pipeline of child processes, the
+	 * output of each stage feeding the next one. Only the output of the last
+	 * stage is delivered.
+	 */
+	bool initPipeline(const std::vector<ChildParams> &stages,
+			DataActionBase *data_action, unsigned int id) {
+		this->child_params = stages.back();
+		this->stages = stages;
+		this->id = id;
+		this->data_action = data_action;
+		return true;
+	}
+
+	/*
+	 * Initializes the thread to run a single child process for a batch of
+	 * jobs. The argument array of the child is argv, whose last element must
+	 * be NULL. Its output gets split into count parts by the splitter.
+	 */
+	bool initBatch(ChildParams child_params, DataActionBase *data_action,
+			unsigned int id, unsigned int count, OutputSplitter *splitter,
+			boost::shared_ptr<std::vector<const char *> > argv) {
+		this->child_params = ChildParams(child_params.getChildProc(),
+				&(*argv)[0], child_params.getVmLimit(),
+				child_params.getCpuLimit());
+		this->id = id;
+		this->count = count;
+		this->data_action = data_action;
+		this->splitter = splitter;
+		this->argv_storage = argv;
+		return true;
+	}
+
+	/*
+	 * Hands the output of the child over to a consumer stage instead of
+	 * running the data actions in this thread.
+	 */
+	void setConsumers(ConsumerStage *consumers) {
+		this->consumers = consumers;
+	}
+
+	/*
+	 * Hands the output of the child over to a reorder buffer, which delivers
+	 * the outputs of all threads in job ID order.
+	 */
+	void setReorderBuffer(ReorderBuffer *reorder) {
+		this->reorder = reorder;
+	}
+
+	/*
+	 * Charges the output of the child to a memory budget. The thread stops
+	 * reading from the child while the budget is exhausted.
+	 */
+	void setMemoryBudget(MemoryBudget *budget) {
+		this->budget = budget;
+	}
+
+	/*
+	 * Records the phases of the job on a trace track.
+	 */
+	void setTrace(TraceBuffer *trace) {
+		this->trace = trace;
+	}
+
+	/*
+	 * Updates the live metrics of the pool.
+	 */
+	void setMetrics(Metrics *metrics) {
+		this->metrics = metrics;
+	}
+
+	/*
+	 * Registers the children with a cancellation, which kills them when the
+	 * run is cancelled, and hands it to the data actions.
+	 */
+	void setCancellation(Cancellation *cancellation) {
+		this->cancellation = cancellation;
+	}
+
+	/*
+	 * Makes the thread one of possibly several attempts of its job. Only the
+	 * first attempt to succeed delivers its output and kills the others,
+	 * through the cancellation, which must be set as well.
+	 */
+	void setClaims(JobClaims *claims) {
+		this->claims = claims;
+	}
+
+	/*
+	 * Runs the child process(es) on the quickly-worker daemon at the given
+	 * address instead of forking them here, authenticated by the given
+	 * secret, which may be NULL. The output is streamed back.
+	 */
+	void setRemote(const char *address, const char *secret) {
+		this->remote = address;
+		this->remote_secret = secret;
+	}
+
+	/*
+	 * Stores whether the job succeeded in *success when the thread
+	 * finishes. Read it only after joining the thread.
+	 */
+	void setSuccess(bool *success) {
+		this->success = success;
+	}
+
 	// overloaded () operator (for Boost.Threading)
 	void operator ()();
 };
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2014 Nedim Srndic, University of Tuebingen
+ *
+ * This file is part of libquickly.
+
+ * libquickly is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libquickly is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libquickly.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * common.h
+ *  Created on: Oct 19, 2026
+ */
+
+/*
+ * Fixtures shared by the test programs.
+ */
+
+#ifndef QUICKLY_TEST_COMMON_H_
+#define QUICKLY_TEST_COMMON_H_
+
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include "../src/DataAction.h"
+
+// The number of failed checks
+static int failures = 0;
+
+/*
+ * Reports a check which failed.
+ */
+static void check(bool condition, const char *what) {
+	if (!condition) {
+		std::cerr << "FAILED: " << what << std::endl;
+		failures++;
+	}
+}
+
+/*
+ * A data action which records the output of every job for the checks. The
+ * instances created for the jobs report to the prototype.
+ */
+class CollectAction: public quickly::DataActionBase {
+private:
+	CollectAction *prototype;
+	CollectAction(unsigned int id, CollectAction *prototype) :
+		DataActionBase(id), prototype(prototype) {
+	}
+public:
+	boost::mutex mutex;
+	// The output of every job
+	std::map<unsigned int, std::string> outputs;
+	// The number of doFull() calls for every job
+	std::map<unsigned int, int> calls;
+	// The jobs in the order of their doFull() calls
+	std::vector<unsigned int> order;
+	// An output which stops the run, empty for none
+	std::string stop_on;
+
+	CollectAction() :
+		DataActionBase(0U), prototype(this) {
+	}
+	virtual CollectAction *create(unsigned int id) {
+		return new CollectAction(id, prototype);
+	}
+	virtual void doFull(std::stringstream &databuf) {
+		boost::mutex::scoped_lock lock(prototype->mutex);
+		prototype->outputs[getId()] = databuf.str();
+		prototype->calls[getId()]++;
+		prototype->order.push_back(getId());
+	}
+	virtual Verdict verdict() {
+		boost::mutex::scoped_lock lock(prototype->mutex);
+		return !prototype->stop_on.empty()
+				&& prototype->outputs[getId()] == prototype->stop_on ? STOP
+				: CONTINUE;
+	}
+	// Returns true if doFull() ran exactly once for each of the first count
+	// jobs and for no others
+	bool allOnce(unsigned int count) {
+		if (calls.size() != count) {
+			return false;
+		}
+		for (unsigned int i = 0; i < count; i++) {
+			if (calls[i] != 1) {
+				return false;
+			}
+		}
+		return true;
+	}
+};
+
+/*
+ * Splits the output of a batch of echo jobs at whitespace.
+ */
+class WordSplitter: public quickly::OutputSplitter {
+public:
+	virtual bool split(std::stringstream &databuf, unsigned int,
+			unsigned int count, std::vector<std::string> &parts) {
+		std::string word;
+		while (databuf >> word) {
+			parts.push_back(word);
+		}
+		return parts.size() == count;
+	}
+};
+
+#endif /* QUICKLY_TEST_COMMON_H_ */
@@ -0,0 +1,96 @@
+/*
+ * Copyright 2014 Nedim Srndic, University of Tuebingen
+ *
+ * This file is part of libquickly.
+
+ * libquickly is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libquickly is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libquickly.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * coroutine.cpp
+ *  Created on: Oct 19, 2026
+ */
+
+/*
+ * Awaits AsyncPool::exec() from coroutines. Only built as C++20.
+ */
+
+#include <cstdlib>
+#include <exception>	// std::terminate()
+#include <string>
+#include <vector>
+
+#include "../src/AsyncPool.h"
+#include "common.h"
+
+#ifndef QUICKLY_HAS_COROUTINES
+#error "This test requires C++20 coroutines"
+#endif
+
+/*
+ * A coroutine which starts right away and cannot be awaited itself.
+ */
+struct Detached {
+	struct promise_type {
+		Detached get_return_object() {
+			return Detached();
+		}
+		std::suspend_never initial_suspend() noexcept {
+			return std::suspend_never();
+		}
+		std::suspend_never final_suspend() noexcept {
+			return std::suspend_never();
+		}
+		void return_void() {
+		}
+		void unhandled_exception() {
+			std::terminate();
+		}
+	};
+};
+
+/*
+ * Runs the jobs one after another, each resuming on an executor thread,
+ * and stores their outputs in order.
+ */
+static Detached runInSequence(quickly::AsyncPool &pool,
+		const std::vector<quickly::ChildParams> &jobs,
+		std::vector<std::string> *outputs) {
+	for (size_t i = 0; i < jobs.size(); i++) {
+		quickly::ChildResult result = co_await pool.exec(jobs[i]);
+		outputs->push_back(result.exitedNormally() ? result.output : "failed");
+	}
+}
+
+int main() {
+	static const char * const argv1[] = {"echo", "one", (char *) NULL};
+	static const char * const argv2[] = {"echo", "two", (char *) NULL};
+	static const char * const argv3[] = {"sh", "-c", "kill -9 $$",
+			(char *) NULL};
+	std::vector<quickly::ChildParams> jobs;
+	jobs.push_back(quickly::ChildParams("/bin/echo", argv1));
+	jobs.push_back(quickly::ChildParams("/bin/echo", argv2));
+	jobs.push_back(quickly::ChildParams("/bin/sh", argv3));
+	std::vector<std::string> first, second;
+	{
+		quickly::AsyncPool pool(2U, 2U);
+		runInSequence(pool, jobs, &first);
+		runInSequence(pool, jobs, &second);
+		// Covers the coroutines, which submit their next job before the
+		// callback of the previous one returns
+		pool.wait();
+	}
+	const std::vector<std::string> expected = {"one\n", "two\n", "failed"};
+	check(first == expected && second == expected,
+			"coroutines resume with the result of every awaited job");
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -22,11 +22,26 @@
 
 #include <iostream>
 #include <cstdlib>
+#include <algorithm>
+#include <climits>	// PIPE_BUF
+#include <cstdio>
 #include <cstring>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
 #include <vector>
 
+#include <stdlib.h>	// mkdtemp()
+#include <unistd.h>	// rmdir()
+#include <boost/bind/bind.hpp>
+#include <boost/thread.hpp>
+
+#include "../src/AsyncPool.h"
 #include "../src/ThreadPool.h"
 #include "../src/DataAction.h"
+#include "common.h"
 
 using std::cout;
 using std::endl;
@@ -59,6 +74,517 @@ public:
 	}
 };
 
+/*
+ * Owns argument arrays for the checks.
+ */
+class ArgvList {
+private:
+	std::deque<std::string> strings;
+	std::deque<std::vector<const char *> > argvs;
+public:
+	// Adds an argument array of up to four arguments, empty ones are left out
+	const char * const *add(const std::string &a0, const std::string &a1 = "",
+			const std::string &a2 = "", const std::string &a3 = "") {
+		const std::string args[] = {a0, a1, a2, a3};
+		argvs.push_back(std::vector<const char *>());
+		for (unsigned int i = 0; i < 4; i++) {
+			if (!args[i].empty()) {
+				strings.push_back(args[i]);
+				argvs.back().push_back(strings.back().c_str());
+			}
+		}
+		argvs.back().push_back((const char *) NULL);
+		return &argvs.back()[0];
+	}
+};
+
+/*
+ * A splitter which cannot split anything.
+ */
+class FailingSplitter: public quickly::OutputSplitter {
+public:
+	virtual bool split(std::stringstream &, unsigned int, unsigned int,
+			std::vector<std::string> &) {
+		return false;
+	}
+};
+
+/*
+ * Returns count jobs for /bin/echo, the output of job i being "job<i>".
+ */
+static std::vector<const char * const *> echoJobs(ArgvList &args,
+		unsigned int count) {
+	std::vector<const char * const *> argvs;
+	for (unsigned int i = 0; i < count; i++) {
+		std::ostringstream word;
+		word << "job" << i;
+		argvs.push_back(args.add("echo", word.str()));
+	}
+	return argvs;
+}
+
+/*
+ * Runs echo jobs in batches and checks that each job gets its own word.
+ */
+static void checkBatching() {
+	ArgvList args;
+	std::vector<const char * const *> argvs = echoJobs(args, 10);
+	CollectAction action;
+	WordSplitter splitter;
+	quickly::ThreadPool pool("/bin/echo", argvs, &action, 2U);
+	pool.setBatching(1U, &splitter);
+	pool.run();
+	check(action.allOnce(10) && action.outputs[0] == "job0"
+			&& action.outputs[9] == "job9"
+			&& pool.getReport().completed.size() == 10, "batched jobs are split");
+	CollectAction consumed;
+	quickly::ThreadPool consumer_pool("/bin/echo", argvs, &consumed, 2U);
+	consumer_pool.setBatching(1U, &splitter);
+	consumer_pool.setConsumers(2U);
+	consumer_pool.run();
+	check(consumed.allOnce(10) && consumer_pool.getReport().completed.size() == 10,
+			"batches split on consumer threads are reported as completed");
+	bool threw = false;
+	try {
+		pool.setBatching(0U, &splitter);
+	} catch (const char *) {
+		threw = true;
+	}
+	check(threw, "the executable name cannot be batched");
+
+	// Batches which cannot be split fail, wherever their actions run
+	FailingSplitter failing;
+	for (unsigned int mode = 0; mode < 3; mode++) {
+		CollectAction unsplit;
+		quickly::ThreadPool fail_pool("/bin/echo", echoJobs(args, 4), &unsplit,
+				2U);
+		fail_pool.setBatching(1U, &failing, 2U);
+		fail_pool.setMaxSuccesses(1U);
+		if (mode == 1) {
+			fail_pool.setConsumers(2U);
+		} else if (mode == 2) {
+			fail_pool.setOrdered(0U);
+		}
+		fail_pool.run();
+		const quickly::RunReport &report = fail_pool.getReport();
+		check(unsplit.calls.empty() && !report.was_cancelled
+				&& report.completed.empty() && report.failed.size() == 4
+				&& fail_pool.getMetrics().jobs_failed.get() == 4
+				&& fail_pool.getMetrics().jobs_finished.get() == 0,
+				"the jobs of a batch which cannot be split fail");
+	}
+}
+
+/*
+ * Runs the data actions on consumer threads.
+ */
+static void checkConsumers() {
+	ArgvList args;
+	CollectAction action;
+	quickly::ThreadPool pool("/bin/echo", echoJobs(args, 12), &action, 2U);
+	pool.setConsumers(2U, 4U);
+	pool.run();
+	check(action.allOnce(12) && action.outputs[11] == "job11\n",
+			"consumers run every data action once");
+	check(pool.getConsumerStats().pushes == 12,
+			"every output passes the consumer queue");
+}
+
+/*
+ * Returns count shell jobs in which later jobs finish earlier.
+ */
+static std::vector<const char * const *> reversedJobs(ArgvList &args,
+		unsigned int count) {
+	std::vector<const char * const *> argvs;
+	for (unsigned int i = 0; i < count; i++) {
+		std::ostringstream command;
+		command << "sleep 0.0" << count - 1 - i << "; echo job" << i;
+		argvs.push_back(args.add("sh", "-c", command.str()));
+	}
+	return argvs;
+}
+
+/*
+ * Delivers the outputs of jobs which finish in reverse order in job ID
+ * order.
+ */
+static void checkOrdered() {
+	ArgvList args;
+	CollectAction action;
+	quickly::ThreadPool pool("/bin/sh", reversedJobs(args, 8), &action, 4U);
+	pool.setOrdered(0U);
+	pool.run();
+	check(action.allOnce(8)
+			&& std::is_sorted(action.order.begin(), action.order.end()),
+			"ordered delivery follows job IDs");
+}
+
+/*
+ * Buffers large outputs under a small memory budget.
+ */
+static void checkMemoryBudget() {
+	ArgvList args;
+	std::vector<const char * const *> argvs(6,
+			args.add("head", "-c", "65536", "/dev/zero"));
+	CollectAction action;
+	quickly::ThreadPool pool("/usr/bin/head", argvs, &action, 3U);
+	pool.setMemoryBudget(16384);
+	pool.run();
+	bool complete = action.allOnce(6);
+	for (unsigned int i = 0; i < 6; i++) {
+		complete = complete && action.outputs[i].size() == 65536;
+	}
+	check(complete, "outputs are complete under a memory budget");
+	check(pool.getMemoryUsage() == 0 && pool.getMemoryPeak() > 0,
+			"the memory budget is released after the run");
+	// Only the oldest job may go over the budget, by at most its own output
+	// plus the read it has reserved room for
+	check(pool.getMemoryPeak() <= 16384 + 65536 + PIPE_BUF,
+			"buffered output stays within the budget and the oldest job");
+}
+
+/*
+ * Returns the path of a new temporary directory for the files of a check.
+ */
+static std::string tempDir() {
+	char dir[] = "/tmp/quickly-test-XXXXXX";
+	if (mkdtemp(dir) == NULL) {
+		check(false, "create a temporary directory");
+		return "/tmp";
+	}
+	return dir;
+}
+
+/*
+ * Returns the contents of a file, or an empty string if it cannot be read.
+ */
+static std::string readFile(const std::string &path) {
+	std::ifstream in(path.c_str());
+	std::stringstream contents;
+	contents << in.rdbuf();
+	return contents.str();
+}
+
+/*
+ * Writes a trace of a run and checks that it shows the job phases.
+ */
+static void checkTrace() {
+	const std::string dir = tempDir();
+	const std::string path = dir + "/trace.json";
+	ArgvList args;
+	CollectAction action;
+	quickly::ThreadPool pool("/bin/echo", echoJobs(args, 4), &action, 2U);
+	pool.setTrace(path.c_str());
+	pool.run();
+	const std::string trace = readFile(path);
+	check(trace.compare(0, 15, "{\"traceEvents\":") == 0
+			&& trace.find("\"name\":\"scheduler\"") != std::string::npos
+			&& trace.find("\"name\":\"slot 1\"") != std::string::npos
+			&& trace.find("\"name\":\"doFull\"") != std::string::npos,
+			"the trace shows the scheduler, the slots and the data actions");
+	std::remove(path.c_str());
+	rmdir(dir.c_str());
+}
+
+static void checkMetrics() {
+	const std::string dir = tempDir();
+	const std::string path = dir + "/metrics.prom";
+	ArgvList args;
+	CollectAction action;
+	quickly::ThreadPool pool("/bin/echo", echoJobs(args, 3), &action, 2U);
+	pool.setMetricsFile(path.c_str());
+	pool.run();
+	const std::string metrics = readFile(path);
+	check(pool.getMetrics().jobs_finished.get() == 3
+			&& pool.getMetrics().jobs_failed.get() == 0,
+			"the metrics count the finished jobs");
+	check(metrics.find("quickly_jobs_finished_total 3\n") != std::string::npos
+			&& metrics.find("quickly_reorder_window_depth ") != std::string::npos,
+			"the metrics file lists the counters and gauges");
+	check(metrics.find("_bucket{le=\"0.000100\"}") != std::string::npos
+			&& metrics.find("e+") == std::string::npos,
+			"the histograms are written in exact decimal seconds");
+	std::remove(path.c_str());
+	rmdir(dir.c_str());
+}
+
+/*
+ * Runs pipelines and jobs with different executables.
+ */
+static void checkPipelines() {
+	ArgvList args;
+	std::vector<std::vector<quickly::ChildParams> > pipelines(3);
+	// yes is killed by SIGPIPE once head exits, which is not a failure
+	pipelines[0].push_back(quickly::ChildParams("/usr/bin/yes", args.add("yes")));
+	pipelines[0].push_back(quickly::ChildParams("/usr/bin/head",
+			args.add("head", "-n", "2")));
+	pipelines[1].push_back(quickly::ChildParams("/bin/echo",
+			args.add("echo", "abc")));
+	pipelines[1].push_back(quickly::ChildParams("/usr/bin/tr",
+			args.add("tr", "a-z", "A-Z")));
+	pipelines[2].push_back(quickly::ChildParams("/bin/echo",
+			args.add("echo", "lost")));
+	pipelines[2].push_back(quickly::ChildParams("/bin/sh",
+			args.add("sh", "-c", "kill -9 $$")));
+	CollectAction action;
+	quickly::ThreadPool pool(pipelines, &action, 2U);
+	pool.run();
+	check(pool.getReport().failed == std::vector<unsigned int>(1, 2U)
+			&& action.calls.size() == 2 && action.outputs[0] == "y\ny\n"
+			&& action.outputs[1] == "ABC\n",
+			"pipelines pass the output of the last stage, a killed stage fails");
+
+	std::vector<quickly::ChildParams> jobs;
+	jobs.push_back(quickly::ChildParams("/bin/echo", args.add("echo", "one")));
+	jobs.push_back(quickly::ChildParams("/usr/bin/printf",
+			args.add("printf", "two")));
+	CollectAction mixed;
+	quickly::ThreadPool mixed_pool(jobs, &mixed, 2U);
+	check(mixed_pool.run() && mixed.allOnce(2) && mixed.outputs[0] == "one\n"
+			&& mixed.outputs[1] == "two", "jobs run their own executables");
+}
+
+// Returns the position of a job in the order of doFull() calls
+static size_t position(const CollectAction &action, unsigned int job) {
+	return std::find(action.order.begin(), action.order.end(), job)
+			- action.order.begin();
+}
+
+/*
+ * Runs jobs with dependencies and costs on a single thread.
+ */
+static void checkDependencies() {
+	ArgvList args;
+	CollectAction action;
+	quickly::ThreadPool pool("/bin/echo", echoJobs(args, 4), &action, 1U);
+	pool.addDependency(0U, 3U);
+	pool.addDependency(1U, 0U);
+	pool.setJobCost(2U, 0.5);
+	check(pool.run() && action.allOnce(4) && position(action, 3) == 0
+			&& position(action, 0) == 1 && position(action, 1) == 2,
+			"jobs start after their prerequisites, on the critical path first");
+
+	std::vector<quickly::ChildParams> jobs;
+	jobs.push_back(quickly::ChildParams("/bin/sh", args.add("sh", "-c",
+			"kill -9 $$")));
+	jobs.push_back(quickly::ChildParams("/bin/echo", args.add("echo", "a")));
+	jobs.push_back(quickly::ChildParams("/bin/echo", args.add("echo", "b")));
+	CollectAction skipping;
+	quickly::ThreadPool skip_pool(jobs, &skipping, 1U);
+	skip_pool.addDependency(1U, 0U);
+	skip_pool.addDependency(2U, 1U);
+	skip_pool.run();
+	check(skipping.calls.empty() && skip_pool.getReport().failed.size() == 3,
+			"jobs depending on a failed job are skipped");
+
+	CollectAction cyclic;
+	quickly::ThreadPool cycle_pool("/bin/echo", echoJobs(args, 3), &cyclic, 1U);
+	cycle_pool.addDependency(0U, 2U);
+	cycle_pool.addDependency(2U, 1U);
+	cycle_pool.addDependency(1U, 0U);
+	check(!cycle_pool.run() && cyclic.calls.empty(),
+			"a run with cyclic dependencies fails");
+
+	CollectAction costly;
+	quickly::ThreadPool cost_pool("/bin/echo", echoJobs(args, 3), &costly, 1U);
+	cost_pool.setJobCost(2U, 10.0);
+	bool threw = false;
+	try {
+		cost_pool.setOrdered(0U);
+	} catch (const char *) {
+		threw = true;
+	}
+	check(!threw && cost_pool.run() && costly.order.size() == 3
+			&& costly.order[0] == 0 && costly.order[2] == 2,
+			"costs without dependencies do not prevent ordered delivery");
+}
+
+// Returns the seconds since start
+static double secondsSince(const boost::posix_time::ptime &start) {
+	return (boost::posix_time::microsec_clock::universal_time() - start)
+			.total_milliseconds() / 1000.0;
+}
+
+// Returns a job which runs the shell command script
+static quickly::ChildParams shellJob(ArgvList &args,
+		const std::string &script) {
+	return quickly::ChildParams("/bin/sh", args.add("sh", "-c", script));
+}
+
+// Cancels a running pool after a moment
+static void cancelSoon(quickly::ThreadPool *pool) {
+	boost::this_thread::sleep(boost::posix_time::milliseconds(200));
+	pool->cancel();
+}
+
+/*
+ * Ends runs early by verdict, by the cancellation policies and by cancel().
+ * The jobs which keep running sleep much longer than any check may take.
+ */
+static void checkCancellation() {
+	ArgvList args;
+	std::vector<quickly::ChildParams> jobs;
+	jobs.push_back(shellJob(args, "sleep 0.1; echo found"));
+	jobs.push_back(quickly::ChildParams("/bin/sleep", args.add("sleep", "30")));
+	jobs.push_back(quickly::ChildParams("/bin/sleep", args.add("sleep", "30")));
+	CollectAction stopping;
+	stopping.stop_on = "found\n";
+	quickly::ThreadPool stop_pool(jobs, &stopping, 2U);
+	boost::posix_time::ptime start =
+			boost::posix_time::microsec_clock::universal_time();
+	stop_pool.run();
+	const quickly::RunReport &stopped = stop_pool.getReport();
+	check(secondsSince(start) < 10 && stopped.was_cancelled
+			&& stopped.completed == std::vector<unsigned int>(1, 0U)
+			&& stopped.cancelled.size() == 2,
+			"a STOP verdict kills the running children and starts no more jobs");
+
+	// These children fork their sleep, which only a process group catches
+	jobs.clear();
+	jobs.push_back(shellJob(args, "sleep 0.1; kill -9 $$"));
+	jobs.push_back(shellJob(args, "sleep 30; echo late"));
+	jobs.push_back(shellJob(args, "sleep 30; echo late"));
+	CollectAction failing;
+	quickly::ThreadPool fail_pool(jobs, &failing, 2U);
+	fail_pool.setMaxFailures(1U);
+	start = boost::posix_time::microsec_clock::universal_time();
+	fail_pool.run();
+	check(secondsSince(start) < 10 && fail_pool.getReport().was_cancelled
+			&& fail_pool.getReport().failed == std::vector<unsigned int>(1, 0U)
+			&& failing.calls.empty(),
+			"setMaxFailures() cancels the run after the given failures");
+
+	jobs[0] = shellJob(args, "sleep 0.1; echo done");
+	CollectAction succeeding;
+	quickly::ThreadPool success_pool(jobs, &succeeding, 2U);
+	success_pool.setMaxSuccesses(1U);
+	start = boost::posix_time::microsec_clock::universal_time();
+	success_pool.run();
+	check(secondsSince(start) < 10 && success_pool.getReport().was_cancelled
+			&& success_pool.getReport().completed
+					== std::vector<unsigned int>(1, 0U)
+			&& succeeding.allOnce(1),
+			"setMaxSuccesses() cancels the run after the given successes");
+
+	// Children run in a process group of their own, reading /dev/null
+	std::vector<quickly::ChildParams> reading(1,
+			quickly::ChildParams("/bin/cat", args.add("cat")));
+	CollectAction read_action;
+	quickly::ThreadPool read_pool(reading, &read_action, 1U);
+	check(read_pool.run() && read_action.allOnce(1)
+			&& read_action.outputs[0].empty(),
+			"children in a process group of their own get no standard input");
+
+	CollectAction cancelled;
+	quickly::ThreadPool cancel_pool("/bin/sleep",
+			std::vector<const char * const *>(3, args.add("sleep", "30")),
+			&cancelled, 2U);
+	start = boost::posix_time::microsec_clock::universal_time();
+	boost::thread canceller(boost::bind(cancelSoon, &cancel_pool));
+	cancel_pool.run();
+	canceller.join();
+	check(secondsSince(start) < 10 && cancel_pool.getReport().was_cancelled
+			&& cancel_pool.getReport().cancelled.size() == 3
+			&& cancelled.calls.empty(),
+			"cancel() from another thread ends the run");
+
+	// Without a policy, the sleeps these children fork still hold their
+	// pipes unless the whole process group is killed
+	jobs.assign(2, shellJob(args, "sleep 5; echo x"));
+	CollectAction forking;
+	quickly::ThreadPool fork_pool(jobs, &forking, 2U);
+	start = boost::posix_time::microsec_clock::universal_time();
+	boost::thread fork_canceller(boost::bind(cancelSoon, &fork_pool));
+	fork_pool.run();
+	fork_canceller.join();
+	check(secondsSince(start) < 1.5 && fork_pool.getReport().cancelled.size() == 2
+			&& forking.calls.empty(),
+			"cancel() also kills the processes the children fork");
+
+	CollectAction waiting;
+	quickly::ThreadPool wait_pool("/bin/sleep",
+			std::vector<const char * const *>(3, args.add("sleep", "30")),
+			&waiting, 1U);
+	wait_pool.addDependency(1U, 0U);
+	wait_pool.addDependency(2U, 0U);
+	boost::thread wait_canceller(boost::bind(cancelSoon, &wait_pool));
+	wait_pool.run();
+	wait_canceller.join();
+	check(wait_pool.getReport().cancelled.size() == 3
+			&& wait_pool.getReport().failed.empty()
+			&& wait_pool.getMetrics().jobs_failed.get() == 0,
+			"jobs depending on a cancelled job are cancelled, not failed");
+}
+
+/*
+ * Re-executes a straggler. Only the first attempt of job 0 gets the lock
+ * directory and hangs, so the run ends quickly only if the second attempt
+ * delivers the output and the first one gets killed.
+ */
+static void checkSpeculation() {
+	const std::string dir = tempDir();
+	ArgvList args;
+	std::vector<quickly::ChildParams> jobs;
+	jobs.push_back(shellJob(args, "if mkdir " + dir + "/lock; then sleep 30; "
+			"fi; echo job0"));
+	for (unsigned int i = 1; i < 4; i++) {
+		std::ostringstream script;
+		script << "sleep 0.05; echo job" << i;
+		jobs.push_back(shellJob(args, script.str()));
+	}
+	CollectAction action;
+	quickly::ThreadPool pool(jobs, &action, 2U);
+	pool.setSpeculation(2.0);
+	const boost::posix_time::ptime start =
+			boost::posix_time::microsec_clock::universal_time();
+	pool.run();
+	check(secondsSince(start) < 10 && action.allOnce(4)
+			&& action.outputs[0] == "job0\n"
+			&& pool.getReport().completed.size() == 4
+			&& pool.getMetrics().speculative_starts.get() == 1,
+			"a straggler is re-executed and delivered once");
+	rmdir((dir + "/lock").c_str());
+	rmdir(dir.c_str());
+}
+
+/*
+ * Collects the results of AsyncPool jobs.
+ */
+struct AsyncResults {
+	boost::mutex mutex;
+	std::map<std::string, int> outputs;
+};
+
+static void collectAsync(AsyncResults *results, quickly::ChildResult &result) {
+	boost::mutex::scoped_lock lock(results->mutex);
+	if (result.exitedNormally()) {
+		results->outputs[result.output]++;
+	}
+}
+
+/*
+ * Runs more children than the AsyncPool has slots and checks that every
+ * result arrives exactly once.
+ */
+static void checkAsyncPool() {
+	static const char * const argv1[] = {"echo", "one", (char *) NULL};
+	static const char * const argv2[] = {"echo", "two", (char *) NULL};
+	static const char * const argv3[] = {"echo", "three", (char *) NULL};
+	AsyncResults results;
+	{
+		quickly::AsyncPool pool(2U, 2U);
+		const quickly::AsyncPool::Callback collect = boost::bind(collectAsync,
+				&results, boost::placeholders::_1);
+		pool.exec(quickly::ChildParams("/bin/echo", argv1), collect);
+		pool.exec(quickly::ChildParams("/bin/echo", argv2), collect);
+		pool.exec(quickly::ChildParams("/bin/echo", argv3), collect);
+		pool.wait();
+	}
+	check(results.outputs.size() == 3 && results.outputs["one\n"] == 1
+			&& results.outputs["two\n"] == 1 && results.outputs["three\n"] == 1,
+			"AsyncPool delivers every result once");
+}
+
 /*
  * Main program (parent executable).
  */
@@ -76,6 +602,19 @@ int main() {
 	bool success = pool.run();
 	cout << "Success: " << success << endl;
 
+	// Check the features of the library
+	checkAsyncPool();
+	checkBatching();
+	checkConsumers();
+	checkOrdered();
+	checkMemoryBudget();
+	checkTrace();
+	checkMetrics();
+	checkPipelines();
+	checkDependencies();
+	checkCancellation();
+	checkSpeculation();
+
 	cout << "\nExiting" << endl;
-	return EXIT_SUCCESS;
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,261 @@
+/*
+ * Copyright 2014 Nedim Srndic, University of Tuebingen
+ *
+ * This file is part of libquickly.
+
+ * libquickly is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libquickly is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with libquickly.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * remote.cpp
+ *  Created on: Oct 19, 2026
+ */
+
+/*
+ * Runs jobs on two quickly-worker daemons listening on unix sockets. The
+ * path of the daemon executable is the only argument.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <signal.h>	// kill()
+#include <stdlib.h>	// mkdtemp()
+#include <sys/socket.h>	// socket(), bind(), listen(), connect()
+#include <sys/stat.h>	// stat()
+#include <sys/un.h>	// sockaddr_un
+#include <sys/wait.h>	// waitpid()
+#include <unistd.h>	// fork(), execv(), rmdir(), unlink()
+#include <boost/bind/bind.hpp>
+#include <boost/thread.hpp>
+
+#include "../src/RemoteProtocol.h"
+#include "../src/ThreadPool.h"
+#include "../src/DataAction.h"
+#include "common.h"
+
+using std::endl;
+
+/*
+ * Starts a daemon listening on address and waits until it accepts
+ * connections. Returns its PID, or -1 if it did not come up.
+ */
+static pid_t startDaemon(const char *daemon, const std::string &address,
+		const std::string &secret_file) {
+	const pid_t pid = fork();
+	if (pid == 0) {
+		if (secret_file.empty()) {
+			execl(daemon, daemon, "--max-jobs", "4", address.c_str(),
+					(const char *) NULL);
+		} else {
+			execl(daemon, daemon, "--max-jobs", "4", "--secret-file",
+					secret_file.c_str(), address.c_str(), (const char *) NULL);
+		}
+		std::exit(EXIT_FAILURE);
+	}
+	for (int i = 0; pid != -1 && i < 500; i++) {
+		const int sock = quickly::connectRemote(address.c_str());
+		if (sock != -1) {
+			close(sock);
+			return pid;
+		}
+		boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+	}
+	return -1;
+}
+
+// Cancels a running pool after a moment
+static void cancelSoon(quickly::ThreadPool *pool) {
+	boost::this_thread::sleep(boost::posix_time::milliseconds(300));
+	pool->cancel();
+}
+
+static void stopDaemon(pid_t pid) {
+	if (pid != -1) {
+		kill(pid, SIGTERM);
+		waitpid(pid, NULL, 0);
+	}
+}
+
+int main(int argc, char *argv[]) {
+	if (argc != 2) {
+		std::cerr << "Usage: " << argv[0] << " QUICKLY_WORKER" << endl;
+		return EXIT_FAILURE;
+	}
+	char dir_template[] = "/tmp/quickly-remote-XXXXXX";
+	const std::string dir(mkdtemp(dir_template));
+	const std::string socks[] = {dir + "/a.sock", dir + "/b.sock"};
+	const std::string addresses[] = {"unix:" + socks[0], "unix:" + socks[1]};
+	// The second daemon only serves pools which know its secret
+	const std::string secret_file = dir + "/secret";
+	std::ofstream(secret_file.c_str()) << "s3cret\n";
+	const pid_t daemons[] = {startDaemon(argv[1], addresses[0], ""),
+			startDaemon(argv[1], addresses[1], secret_file)};
+	check(daemons[0] != -1 && daemons[1] != -1, "the daemons start");
+	struct stat sock_stat;
+	check(stat(socks[0].c_str(), &sock_stat) == 0
+			&& (sock_stat.st_mode & 0777) == 0600,
+			"only the owner may connect to a unix socket");
+
+	// Every job prints the PID of the process which started it, so that the
+	// outputs tell where the jobs ran
+	const unsigned int JOB_COUNT = 24;
+	const char * const job_argv[] = {"sh", "-c", "sleep 0.05; echo $PPID",
+			(const char *) NULL};
+	CollectAction action;
+	quickly::ThreadPool pool("/bin/sh",
+			std::vector<const char * const *>(JOB_COUNT, job_argv), &action, 1U);
+	pool.addRemoteNode(addresses[0].c_str(), 2U);
+	pool.addRemoteNode(addresses[1].c_str(), 2U, "s3cret");
+	pool.run();
+	std::set<std::string> hosts;
+	for (unsigned int i = 0; i < JOB_COUNT; i++) {
+		hosts.insert(action.outputs[i]);
+	}
+	std::ostringstream daemon_a, daemon_b;
+	daemon_a << daemons[0] << "\n";
+	daemon_b << daemons[1] << "\n";
+	check(action.allOnce(JOB_COUNT)
+			&& pool.getReport().completed.size() == JOB_COUNT,
+			"every job's output is delivered exactly once");
+	check(hosts.count(daemon_a.str()) == 1 && hosts.count(daemon_b.str()) == 1,
+			"jobs run on both daemons");
+
+	// The batches are far longer than a spawn request may carry, unless they
+	// are cut to fit for the daemon
+	const unsigned int BATCH_JOBS = 40000;
+	std::vector<std::string> words(BATCH_JOBS);
+	std::vector<std::vector<const char *> > batch_argvs(BATCH_JOBS);
+	std::vector<const char * const *> batch_jobs(BATCH_JOBS);
+	for (unsigned int i = 0; i < BATCH_JOBS; i++) {
+		std::ostringstream word;
+		word << "job" << i;
+		words[i] = word.str();
+		batch_argvs[i].push_back("echo");
+		batch_argvs[i].push_back(words[i].c_str());
+		batch_argvs[i].push_back((const char *) NULL);
+		batch_jobs[i] = &batch_argvs[i][0];
+	}
+	CollectAction batched;
+	WordSplitter splitter;
+	quickly::ThreadPool batch_pool("/bin/echo", batch_jobs, &batched, 1U);
+	batch_pool.setBatching(1U, &splitter);
+	batch_pool.addRemoteNode(addresses[0].c_str(), 1U);
+	batch_pool.run();
+	check(batched.allOnce(BATCH_JOBS) && batched.outputs[BATCH_JOBS - 1]
+			== words[BATCH_JOBS - 1]
+			&& batch_pool.getReport().completed.size() == BATCH_JOBS,
+			"batches sent to a daemon fit into a spawn request");
+
+	// The remote slot comes after the local one, so the second of two
+	// concurrent jobs goes to the daemon, which rejects the wrong secret
+	const char * const slow_argv[] = {"sh", "-c", "sleep 0.2; echo done",
+			(const char *) NULL};
+	CollectAction rejected;
+	quickly::ThreadPool rejected_pool("/bin/sh",
+			std::vector<const char * const *>(2, slow_argv), &rejected, 1U);
+	rejected_pool.addRemoteNode(addresses[1].c_str(), 1U, "guess");
+	rejected_pool.run();
+	check(rejected_pool.getReport().failed.size() == 1
+			&& rejected_pool.getReport().completed.size() == 1,
+			"a daemon rejects jobs without its secret");
+
+	// The remote slot comes after the local one, so the second of two
+	// concurrent jobs goes to the node which does not exist
+	const std::string missing = "unix:" + dir + "/missing \"\\.sock";
+	CollectAction lost;
+	quickly::ThreadPool lost_pool("/bin/sh",
+			std::vector<const char * const *>(2, slow_argv), &lost, 1U);
+	lost_pool.addRemoteNode(missing.c_str(), 1U);
+	const std::string trace_path = dir + "/trace.json";
+	lost_pool.setTrace(trace_path.c_str());
+	lost_pool.run();
+	check(lost_pool.getReport().failed.size() == 1
+			&& lost_pool.getReport().completed.size() == 1 && lost.calls.size() == 1,
+			"a job fails when its daemon cannot be reached");
+	std::ifstream trace_file(trace_path.c_str());
+	std::ostringstream trace;
+	trace << trace_file.rdbuf();
+	check(trace.str().find("/missing \\\"\\\\.sock)\"") != std::string::npos,
+			"the trace escapes the addresses in track names");
+	std::remove(trace_path.c_str());
+
+	// A daemon which never accepts, with a full backlog, keeps the
+	// connection pending until the run is cancelled
+	const std::string stuck = dir + "/stuck.sock";
+	struct sockaddr_un stuck_addr;
+	std::memset(&stuck_addr, 0, sizeof(stuck_addr));
+	stuck_addr.sun_family = AF_UNIX;
+	std::strncpy(stuck_addr.sun_path, stuck.c_str(),
+			sizeof(stuck_addr.sun_path) - 1);
+	const int stuck_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	bind(stuck_fd, (struct sockaddr *) &stuck_addr, sizeof(stuck_addr));
+	listen(stuck_fd, 0);
+	std::vector<int> waiting;
+	while (waiting.size() < 16) {
+		const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+		waiting.push_back(fd);
+		if (connect(fd, (struct sockaddr *) &stuck_addr, sizeof(stuck_addr))
+				== -1) {
+			break;
+		}
+	}
+	const char * const sleep_argv[] = {"sleep", "30", (const char *) NULL};
+	CollectAction pending;
+	quickly::ThreadPool pending_pool("/bin/sleep",
+			std::vector<const char * const *>(2, sleep_argv), &pending, 1U);
+	pending_pool.addRemoteNode(("unix:" + stuck).c_str(), 1U);
+	boost::posix_time::ptime start =
+			boost::posix_time::microsec_clock::universal_time();
+	boost::thread pending_canceller(boost::bind(cancelSoon, &pending_pool));
+	pending_pool.run();
+	pending_canceller.join();
+	check((boost::posix_time::microsec_clock::universal_time() - start)
+			.total_milliseconds() < 2000
+			&& pending_pool.getReport().cancelled.size() == 2,
+			"cancel() stops waiting for a daemon to accept");
+	for (size_t i = 0; i < waiting.size(); i++) {
+		close(waiting[i]);
+	}
+	close(stuck_fd);
+	unlink(stuck.c_str());
+
+	// A remote job which never stops writing is killed by cancel()
+	const char * const chatty_argv[] = {"sh", "-c",
+			"while :; do echo y; sleep 0.001; done", (const char *) NULL};
+	CollectAction chatty;
+	quickly::ThreadPool chatty_pool("/bin/sh",
+			std::vector<const char * const *>(2, chatty_argv), &chatty, 1U);
+	chatty_pool.addRemoteNode(addresses[0].c_str(), 1U);
+	start = boost::posix_time::microsec_clock::universal_time();
+	boost::thread canceller(boost::bind(cancelSoon, &chatty_pool));
+	chatty_pool.run();
+	canceller.join();
+	check((boost::posix_time::microsec_clock::universal_time() - start)
+			.total_seconds() < 10 && chatty_pool.getReport().cancelled.size() == 2,
+			"cancel() kills a remote job which keeps writing");
+
+	stopDaemon(daemons[0]);
+	stopDaemon(daemons[1]);
+	unlink(socks[0].c_str());
+	unlink(socks[1].c_str());
+	unlink(secret_file.c_str());
+	rmdir(dir.c_str());
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}